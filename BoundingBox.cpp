@@ -0,0 +1,160 @@
+#include "BoundingBox.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define USE_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_NEON
+#endif
+
+namespace SceneGraph {
+
+BoundingBox::BoundingBox() : m_empty(true), m_infinite() {}
+
+BoundingBox::BoundingBox(QVector3D min, QVector3D max)
+    : m_min(min), m_max(max), m_empty(), m_infinite() {}
+
+BoundingBox BoundingBox::infinite() {
+  BoundingBox box(QVector3D(-FLT_MAX, -FLT_MAX, -FLT_MAX),
+                  QVector3D(FLT_MAX, FLT_MAX, FLT_MAX));
+  box.m_infinite = true;
+  return box;
+}
+
+BoundingBox BoundingBox::fromPoints(const void* data, size_t size,
+                                    uint count, uint stride, int tupleSize) {
+  assert(tupleSize >= 1 && tupleSize <= 4);
+  if (count == 0) return BoundingBox();
+  assert(size >= size_t(count - 1) * stride + tupleSize * sizeof(float));
+
+  const char* ptr = static_cast<const char*>(data);
+  float min[4] = {FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX};
+  float max[4] = {-FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+  // Full four lane loads are only safe while they stay inside the readable
+  // bytes, the remaining points are handled by the scalar loop.
+  uint simdCount = 0;
+#if defined(USE_SSE) || defined(USE_NEON)
+  if (size >= 4 * sizeof(float))
+    simdCount = uint(std::min<size_t>(
+        count, (size - 4 * sizeof(float)) / stride + 1));
+#endif
+
+#if defined(USE_SSE)
+  __m128 vmin = _mm_loadu_ps(min), vmax = _mm_loadu_ps(max);
+  for (uint i = 0; i < simdCount; i++) {
+    __m128 v = _mm_loadu_ps(reinterpret_cast<const float*>(ptr + i * stride));
+    vmin = _mm_min_ps(vmin, v);
+    vmax = _mm_max_ps(vmax, v);
+  }
+  _mm_storeu_ps(min, vmin);
+  _mm_storeu_ps(max, vmax);
+#elif defined(USE_NEON)
+  float32x4_t vmin = vld1q_f32(min), vmax = vld1q_f32(max);
+  for (uint i = 0; i < simdCount; i++) {
+    float32x4_t v = vld1q_f32(reinterpret_cast<const float*>(ptr + i * stride));
+    vmin = vminq_f32(vmin, v);
+    vmax = vmaxq_f32(vmax, v);
+  }
+  vst1q_f32(min, vmin);
+  vst1q_f32(max, vmax);
+#endif
+
+  for (uint i = simdCount; i < count; i++) {
+    float v[4];
+    memcpy(v, ptr + i * stride, tupleSize * sizeof(float));
+    for (int j = 0; j < tupleSize; j++) {
+      min[j] = std::min(min[j], v[j]);
+      max[j] = std::max(max[j], v[j]);
+    }
+  }
+
+  for (int j = tupleSize; j < 3; j++) min[j] = max[j] = 0;
+
+  return BoundingBox(QVector3D(min[0], min[1], min[2]),
+                     QVector3D(max[0], max[1], max[2]));
+}
+
+void BoundingBox::unite(const BoundingBox& box) {
+  if (box.isEmpty()) return;
+  if (isEmpty()) {
+    *this = box;
+    return;
+  }
+
+  for (int i = 0; i < 3; i++) {
+    m_min[i] = std::min(m_min[i], box.m_min[i]);
+    m_max[i] = std::max(m_max[i], box.m_max[i]);
+  }
+  m_infinite |= box.m_infinite;
+}
+
+bool BoundingBox::project(const QMatrix4x4& matrix, QRectF& ndc) const {
+  if (m_infinite) return false;
+
+  ndc = QRectF();
+  if (m_empty) return true;
+
+  for (int i = 0; i < 8; i++) {
+    QVector4D p = matrix * QVector4D(i & 1 ? m_max.x() : m_min.x(),
+                                     i & 2 ? m_max.y() : m_min.y(),
+                                     i & 4 ? m_max.z() : m_min.z(), 1);
+    if (p.w() <= 0) return false;
+
+    QPointF point(p.x() / p.w(), p.y() / p.w());
+    ndc = i == 0 ? QRectF(point, point) : ndc.united(QRectF(point, point));
+  }
+  return true;
+}
+
+BoundingBox BoundingBox::transformed(const QMatrix4x4& matrix) const {
+  if (isEmpty() || isInfinite()) return *this;
+
+  BoundingBox box;
+  for (int i = 0; i < 8; i++) {
+    QVector3D p(i & 1 ? m_max.x() : m_min.x(), i & 2 ? m_max.y() : m_min.y(),
+                i & 4 ? m_max.z() : m_min.z());
+    p = matrix.map(p);
+    box.unite(BoundingBox(p, p));
+  }
+  return box;
+}
+
+Frustum::Frustum(const QMatrix4x4& matrix, QRectF ndc) {
+  QVector4D x = matrix.row(0), y = matrix.row(1), z = matrix.row(2),
+            w = matrix.row(3);
+
+  m_plane[0] = x - float(ndc.left()) * w;
+  m_plane[1] = float(ndc.right()) * w - x;
+  m_plane[2] = y - float(ndc.top()) * w;
+  m_plane[3] = float(ndc.bottom()) * w - y;
+  m_plane[4] = w + z;
+  m_plane[5] = w - z;
+}
+
+Frustum::Result Frustum::test(const BoundingBox& box) const {
+  if (box.isEmpty()) return Result::Outside;
+  if (box.isInfinite()) return Result::Intersecting;
+
+  Result result = Result::Inside;
+  for (const QVector4D& plane : m_plane) {
+    QVector4D p(plane.x() > 0 ? box.max().x() : box.min().x(),
+                plane.y() > 0 ? box.max().y() : box.min().y(),
+                plane.z() > 0 ? box.max().z() : box.min().z(), 1);
+    if (QVector4D::dotProduct(plane, p) < 0) return Result::Outside;
+
+    QVector4D n(plane.x() > 0 ? box.min().x() : box.max().x(),
+                plane.y() > 0 ? box.min().y() : box.max().y(),
+                plane.z() > 0 ? box.min().z() : box.max().z(), 1);
+    if (QVector4D::dotProduct(plane, n) < 0) result = Result::Intersecting;
+  }
+
+  return result;
+}
+}  // namespace SceneGraph
@@ -0,0 +1,58 @@
+#ifndef BOUNDINGBOX_HPP
+#define BOUNDINGBOX_HPP
+#include <QMatrix4x4>
+#include <QRectF>
+#include <QVector3D>
+#include <QVector4D>
+
+namespace SceneGraph {
+
+class BoundingBox {
+ private:
+  QVector3D m_min;
+  QVector3D m_max;
+  bool m_empty;
+  bool m_infinite;
+
+ public:
+  BoundingBox();
+  BoundingBox(QVector3D min, QVector3D max);
+
+  static BoundingBox infinite();
+
+  // Computes the box of count points stored every stride bytes, each with
+  // tupleSize floats. Size is the number of bytes readable from data, which
+  // can end right after the last point.
+  static BoundingBox fromPoints(const void* data, size_t size, uint count,
+                                uint stride, int tupleSize);
+
+  inline const QVector3D& min() const { return m_min; }
+  inline const QVector3D& max() const { return m_max; }
+
+  inline bool isEmpty() const { return m_empty; }
+  inline bool isInfinite() const { return m_infinite; }
+
+  void unite(const BoundingBox&);
+  BoundingBox transformed(const QMatrix4x4&) const;
+
+  // Rectangle in normalized device coordinates covered by the box, fails for
+  // boxes reaching behind the eye.
+  bool project(const QMatrix4x4&, QRectF& ndc) const;
+};
+
+class Frustum {
+ private:
+  QVector4D m_plane[6];
+
+ public:
+  enum class Result { Outside, Intersecting, Inside };
+
+  // Planes of the volume which matrix maps into the given rectangle of
+  // normalized device coordinates.
+  Frustum(const QMatrix4x4& matrix, QRectF ndc = QRectF(-1, -1, 2, 2));
+
+  Result test(const BoundingBox&) const;
+};
+}  // namespace SceneGraph
+
+#endif  // BOUNDINGBOX_HPP
@@ -1,5 +1,6 @@
 #include "DefaultRenderer.hpp"
 #include <QElapsedTimer>
+#include <QMutex>
 #include <cassert>
 #include "Geometry.hpp"
 #include "Material.hpp"
@@ -16,20 +17,23 @@ void DefaultRenderer::renderGeometryNode(GeometryNode* node,
   Shader* shader = material->shader();
   assert(shader);
 
-  if (!shader->initialized()) shader->initialize();
+  if (!prepareShader(shader)) return;
+
+  QMutexLocker lock(renderMutex());
+  Geometry* g = node->geometry();
+  assert(g);
+  // Names are compared once per shader, later draws compare a pointer.
+  if (!g->checkAttributes(shader)) return;
 
   shader->bind();
   shader->activate();
 
   shader->updateState(material, state);
 
-  Geometry* g = node->geometry();
-  assert(g);
-
   g->bind(shader->attributeLocation());
   if (g->indexCount())
     glDrawElements(g->drawingMode(), g->indexCount(), g->indexType(),
-                   g->indexData());
+                   nullptr);
   else
     glDrawArrays(g->drawingMode(), 0, g->vertexCount());
   g->release();
@@ -37,11 +41,12 @@ void DefaultRenderer::renderGeometryNode(GeometryNode* node,
   shader->deactivate();
 }
 
-void DefaultRenderer::render() {
+void DefaultRenderer::beginFrame() {
   glClearColor(1, 1, 1, 0);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
 
+void DefaultRenderer::render() {
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
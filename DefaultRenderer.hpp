@@ -8,6 +8,7 @@ namespace SceneGraph {
 class DefaultRenderer : public Renderer {
  protected:
   void renderGeometryNode(GeometryNode *node, const RenderState &);
+  void beginFrame();
 
  public:
   DefaultRenderer();
@@ -1,9 +1,23 @@
 #include "Geometry.hpp"
 #include <QDebug>
 #include <cassert>
+#include "Shader.hpp"
+#include "VertexFormat.hpp"
 
 namespace SceneGraph {
 
+namespace {
+
+// FNV-1a.
+uint64_t combine(uint64_t hash, const void* data, size_t size) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; i++) hash = (hash ^ p[i]) * 1099511628211ull;
+  return hash;
+}
+}  // namespace
+
+std::atomic<size_t> Geometry::s_residentBytes(0);
+
 Geometry::Geometry(std::vector<Attribute> set, uint vertexCount,
                    uint vertexSize, uint indexCount, uint indexType)
     : m_attribute(set),
@@ -15,71 +29,270 @@ Geometry::Geometry(std::vector<Attribute> set, uint vertexCount,
       m_indexType(indexType),
       m_indexData(),
       m_indexDataSize(),
-      m_drawingMode(GL_TRIANGLE_STRIP) {
+      m_drawingMode(GL_TRIANGLE_STRIP),
+      m_customBoundingBox(),
+      m_retention(Retention::Keep),
+      m_checkedShader(),
+      m_contentHash(),
+      m_contentHashed() {
   initializeOpenGLFunctions();
 
   glGenBuffers(1, &m_vbo);
+  glGenBuffers(1, &m_ibo);
   allocate(vertexCount, indexCount);
 }
 
 Geometry::~Geometry() {
   glDeleteBuffers(1, &m_vbo);
+  glDeleteBuffers(1, &m_ibo);
 
-  if (m_vertexData) free(m_vertexData);
-  if (m_indexData) free(m_indexData);
+  freeData();
 }
 
 void Geometry::allocate(uint vertexCount, uint indexCount) {
+  s_residentBytes -= cpuBytes();
+
   if (m_vertexDataSize != vertexCount) {
     m_vertexDataSize = m_vertexCount = vertexCount;
 
-    uint size = vertexCount * vertexSize();
+    size_t size = size_t(vertexCount) * vertexSize();
+    if (!vertexCount) free(m_vertexData);
     m_vertexData = vertexCount ? realloc(m_vertexData, size) : 0;
   }
 
   if (m_indexDataSize != indexCount) {
     m_indexDataSize = m_indexCount = indexCount;
 
-    uint size = indexCount * sizeOfType(indexType());
+    size_t size = size_t(indexCount) * sizeOfType(indexType());
+    if (!indexCount) free(m_indexData);
     m_indexData = indexCount ? realloc(m_indexData, size) : 0;
   }
+
+  s_residentBytes += cpuBytes();
+}
+
+void Geometry::setIndexType(uint type) {
+  if (type == m_indexType) return;
+  s_residentBytes -= cpuBytes();
+
+  m_indexType = type;
+  if (m_indexDataSize)
+    m_indexData = realloc(m_indexData, m_indexDataSize * sizeOfType(type));
+
+  s_residentBytes += cpuBytes();
+}
+
+void Geometry::freeData() {
+  s_residentBytes -= cpuBytes();
+
+  free(m_vertexData);
+  free(m_indexData);
+  m_vertexData = m_indexData = nullptr;
+  m_vertexDataSize = m_indexDataSize = 0;
+}
+
+size_t Geometry::cpuBytes() const {
+  return size_t(m_vertexDataSize) * vertexSize() +
+         size_t(m_indexDataSize) * sizeOfType(indexType());
+}
+
+bool Geometry::materialize() {
+  if (hasData()) return true;
+  if (!m_loader) return false;
+
+  uint vertexCount = m_vertexCount, indexCount = m_indexCount;
+  allocate(vertexCount, indexCount);
+  m_loader(this);
+  return true;
 }
 
 void Geometry::updateVertexData() {
+  assert(hasData());
+  upload(vertexData(), indexData());
+
+  if (!m_customBoundingBox) updateBoundingBox();
+
+  // Counts stay, so the data can be allocated again at the same size.
+  if (m_retention != Retention::Keep) {
+    m_contentHash = hashContent(vertexData(), indexData());
+    m_contentHashed = true;
+    freeData();
+  }
+}
+
+void Geometry::updateVertexData(const void* vertexData,
+                                const void* indexData) {
+  upload(vertexData, indexData);
+  m_contentHash = hashContent(vertexData, indexData);
+  m_contentHashed = true;
+}
+
+void Geometry::upload(const void* vertexData, const void* indexData) {
   glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-  glBufferData(GL_ARRAY_BUFFER, vertexCount() * vertexSize(), vertexData(),
-               GL_STATIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, size_t(vertexCount()) * vertexSize(),
+               vertexData, GL_STATIC_DRAW);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  if (indexCount()) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 size_t(indexCount()) * sizeOfType(indexType()), indexData,
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  }
 }
 
-void Geometry::bind(const int* attributeLocation) {
+void Geometry::allocateBuffers() {
+  upload(nullptr, nullptr);
+  m_contentHashed = false;
+}
+
+void Geometry::updateVertexRange(size_t offset, size_t size,
+                                 const void* data) {
+  m_contentHashed = false;
   glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+  glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Geometry::updateIndexRange(size_t offset, size_t size,
+                                const void* data) {
+  m_contentHashed = false;
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+  glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, size, data);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+uint64_t Geometry::contentHash() const {
+  assert(hasContentHash());
+  return hasData() ? hashContent(vertexData(), indexData()) : m_contentHash;
+}
+
+uint64_t Geometry::hashContent(const void* vertexData,
+                               const void* indexData) const {
+  uint64_t h = 14695981039346656037ull;
+  for (const Attribute& a : attribute()) {
+    int field[] = {a.tupleSize, a.primitiveType, a.normalized, a.offset};
+    h = combine(h, field, sizeof(field));
+  }
+  uint header[] = {vertexCount(), vertexSize(), indexCount(), indexType(),
+                   drawingMode()};
+  h = combine(h, header, sizeof(header));
+  h = combine(h, vertexData, size_t(vertexCount()) * vertexSize());
+  return combine(h, indexData, size_t(indexCount()) * sizeOfType(indexType()));
+}
+
+void Geometry::updateBoundingBox() {
+  if (!hasData()) return;
+
+  if (attribute().empty() || attribute()[0].primitiveType != GL_FLOAT ||
+      attribute()[0].tupleSize > 4) {
+    m_boundingBox = BoundingBox::infinite();
+    return;
+  }
+  if (!vertexCount()) {
+    m_boundingBox = BoundingBox();
+    return;
+  }
+
+  // The points start at the attribute, so fewer bytes are left to read.
+  uint offset = attributeOffset(0);
+  size_t size = size_t(vertexCount()) * vertexSize() - offset;
+  m_boundingBox =
+      BoundingBox::fromPoints(vertexData<char>() + offset, size, vertexCount(),
+                              vertexSize(), attribute()[0].tupleSize);
+}
+
+void Geometry::setBoundingBox(const BoundingBox& box) {
+  m_boundingBox = box;
+  m_customBoundingBox = true;
+}
+
+void Geometry::bindBuffers() {
+  glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+  if (indexCount()) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+}
+
+void Geometry::bind(const int* attributeLocation) {
+  bindBuffers();
 
   uint id = 0, offset = 0;
   for (Attribute attribute : Geometry::attribute()) {
+    if (attribute.offset >= 0) offset = attribute.offset;
     glEnableVertexAttribArray(attributeLocation[id]);
     glVertexAttribPointer(attributeLocation[id], attribute.tupleSize,
-                          attribute.primitiveType, GL_FALSE, vertexSize(),
-                          (void*)(size_t(offset)));
+                          attribute.primitiveType,
+                          attribute.normalized ? GL_TRUE : GL_FALSE,
+                          vertexSize(), (void*)(size_t(offset)));
     id++;
-    offset += attribute.tupleSize * sizeOfType(attribute.primitiveType);
+    offset += sizeOfAttribute(attribute);
   }
 }
 
-void Geometry::release() { glBindBuffer(GL_ARRAY_BUFFER, 0); }
+void Geometry::bindPosition(int attributeLocation) {
+  bindBuffers();
+
+  const Attribute& position = attribute()[0];
+  glEnableVertexAttribArray(attributeLocation);
+  glVertexAttribPointer(attributeLocation, position.tupleSize,
+                        position.primitiveType,
+                        position.normalized ? GL_TRUE : GL_FALSE, vertexSize(),
+                        (void*)(size_t(attributeOffset(0))));
+}
+
+std::vector<std::string> Geometry::attributeName() const { return {}; }
+
+bool Geometry::checkAttributes(const Shader* shader) {
+  if (shader == m_checkedShader) return true;
+
+  std::vector<std::string> name = attributeName();
+  if (!name.empty() && name != shader->attribute()) {
+    qDebug() << "[FAIL] Geometry attributes don't match the shader's.";
+    return false;
+  }
+
+  m_checkedShader = shader;
+  return true;
+}
+
+uint Geometry::attributeOffset(uint index) const {
+  uint offset = 0;
+  for (uint i = 0; i <= index; i++) {
+    if (attribute()[i].offset >= 0) offset = attribute()[i].offset;
+    if (i < index) offset += sizeOfAttribute(attribute()[i]);
+  }
+  return offset;
+}
+
+void Geometry::release() {
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
 
 uint Geometry::sizeOfType(GLuint type) {
   if (type == GL_FLOAT)
     return sizeof(GLfloat);
-  else if (type == GL_UNSIGNED_BYTE)
+  else if (type == GL_UNSIGNED_BYTE || type == GL_BYTE)
     return sizeof(GLubyte);
-  else if (type == GL_UNSIGNED_SHORT)
+  else if (type == GL_UNSIGNED_SHORT || type == GL_SHORT)
     return sizeof(GLushort);
-  else if (type == GL_UNSIGNED_INT)
+  else if (type == GL_UNSIGNED_INT || type == GL_INT)
+    return sizeof(GLuint);
+  else if (type == VertexFormat::HALF_FLOAT ||
+           type == VertexFormat::HALF_FLOAT_OES)
+    return sizeof(GLushort);
+  else if (type == VertexFormat::INT_2_10_10_10_REV ||
+           type == VertexFormat::UNSIGNED_INT_2_10_10_10_REV)
     return sizeof(GLuint);
   else {
     assert(false);
     return 0;
   }
 }
+
+uint Geometry::sizeOfAttribute(const Attribute& attribute) {
+  if (VertexFormat::isPacked(attribute.primitiveType))
+    return sizeOfType(attribute.primitiveType);
+  return attribute.tupleSize * sizeOfType(attribute.primitiveType);
+}
 }  // namespace SceneGraph
@@ -1,20 +1,45 @@
 #ifndef GEOMETRY_HPP
 #define GEOMETRY_HPP
 #include <QOpenGLFunctions>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "BoundingBox.hpp"
 
 namespace SceneGraph {
 
+class Shader;
+
 #undef M_PI
 const float M_PI = 3.14159265358979323846;
 
 struct Attribute {
   int tupleSize;
   int primitiveType;
+  // Integer components read as [0, 1], or [-1, 1] for signed types.
+  bool normalized = false;
+  // Bytes from the start of the vertex, negative to follow the previous
+  // attribute.
+  int offset = -1;
 };
 
+inline bool operator==(const Attribute& a, const Attribute& b) {
+  return a.tupleSize == b.tupleSize && a.primitiveType == b.primitiveType &&
+         a.normalized == b.normalized && a.offset == b.offset;
+}
+
 class Geometry : public QOpenGLFunctions {
+ public:
+  // What happens to the CPU copy of the data once it is uploaded. Reload
+  // discards it too, but materialize() can bring it back through the loader.
+  enum class Retention { Keep, Discard, Reload };
+
+  using Loader = std::function<void(Geometry*)>;
+
  private:
   GLuint m_vbo;
+  GLuint m_ibo;
   std::vector<Attribute> m_attribute;
   uint m_vertexCount;
   uint m_vertexSize;
@@ -25,6 +50,27 @@ class Geometry : public QOpenGLFunctions {
   void* m_indexData;
   uint m_indexDataSize;
   uint m_drawingMode;
+  BoundingBox m_boundingBox;
+  bool m_customBoundingBox;
+  Retention m_retention;
+  Loader m_loader;
+  const Shader* m_checkedShader;
+  uint64_t m_contentHash;
+  bool m_contentHashed;
+
+  static std::atomic<size_t> s_residentBytes;
+
+  void freeData();
+  void upload(const void* vertexData, const void* indexData);
+  uint64_t hashContent(const void* vertexData, const void* indexData) const;
+
+ protected:
+  // Binds the vertex and index buffers, for bind() implementations.
+  void bindBuffers();
+
+  // Names of the attributes in order, empty when the geometry doesn't know
+  // them.
+  virtual std::vector<std::string> attributeName() const;
 
  public:
   Geometry(std::vector<Attribute> set, uint vertexCount, uint vertexSize,
@@ -32,11 +78,51 @@ class Geometry : public QOpenGLFunctions {
   virtual ~Geometry();
 
   void allocate(uint vertexCount, uint indexCount);
+  // Uploads the vertices and indices, afterwards drawing reads indices from
+  // the bound element buffer.
   void updateVertexData();
+  // Uploads vertices and indices from memory the geometry does not own, e.g.
+  // a mapped file, without a CPU copy. Counts have to be set beforehand.
+  void updateVertexData(const void* vertexData, const void* indexData);
+  void updateBoundingBox();
+
+  // Sizes the buffers for the current counts, to be filled in ranges.
+  void allocateBuffers();
+  void updateVertexRange(size_t offset, size_t size, const void* data);
+  void updateIndexRange(size_t offset, size_t size, const void* data);
+
+  inline Retention retention() const { return m_retention; }
+  inline void setRetention(Retention r) { m_retention = r; }
+
+  // Fills the allocated vertex and index data again, for Retention::Reload.
+  inline void setLoader(Loader l) { m_loader = std::move(l); }
+
+  // Brings back discarded data, returns whether it is available.
+  bool materialize();
+  inline bool hasData() const {
+    return (m_vertexData || !m_vertexCount) && (m_indexData || !m_indexCount);
+  }
+
+  // Hash of the layout and contents, kept from the last upload once the data
+  // is gone so identical geometries can still be recognized. Not available
+  // for buffers filled in ranges.
+  inline bool hasContentHash() const { return hasData() || m_contentHashed; }
+  uint64_t contentHash() const;
+
+  // CPU memory held for vertex and index data, by this geometry and by all.
+  size_t cpuBytes() const;
+  static inline size_t residentBytes() { return s_residentBytes.load(); }
 
-  void bind(const int* attributeLocation);
+  virtual void bind(const int* attributeLocation);
+  // Binds only the first attribute, for shaders reading positions alone.
+  void bindPosition(int attributeLocation);
   void release();
 
+  // Whether the attribute names match the ones of the shader, which binds
+  // its locations in order. Compared once per shader, geometries without
+  // names always match.
+  bool checkAttributes(const Shader*);
+
   inline const std::vector<Attribute>& attribute() const { return m_attribute; }
 
   inline uint vertexDataSize() const { return m_vertexDataSize; }
@@ -50,10 +136,18 @@ class Geometry : public QOpenGLFunctions {
 
   inline uint vertexSize() const { return m_vertexSize; }
   inline uint indexType() const { return m_indexType; }
+  // Resizes the allocated indices for the type, their values have to be
+  // written again.
+  void setIndexType(uint);
 
   inline uint drawingMode() const { return m_drawingMode; }
   inline void setDrawingMode(uint m) { m_drawingMode = m; }
 
+  // Box of the first attribute, recomputed by updateVertexData() unless set
+  // explicitly for shaders which move vertices around.
+  inline const BoundingBox& boundingBox() const { return m_boundingBox; }
+  void setBoundingBox(const BoundingBox&);
+
   template <class T = void>
   inline T* vertexData() const {
     return static_cast<T*>(m_vertexData);
@@ -64,7 +158,12 @@ class Geometry : public QOpenGLFunctions {
     return static_cast<T*>(m_indexData);
   }
 
+  // Bytes from the start of the vertex to the attribute.
+  uint attributeOffset(uint index) const;
+
   static uint sizeOfType(GLuint type);
+  // Packed types hold the whole tuple in their size.
+  static uint sizeOfAttribute(const Attribute&);
 };
 }  // namespace SceneGraph
 
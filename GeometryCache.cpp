@@ -0,0 +1,75 @@
+#include "GeometryCache.hpp"
+#include <cstring>
+#include "Geometry.hpp"
+
+namespace SceneGraph {
+
+GeometryCache::GeometryCache() : m_statistics() {}
+
+GeometryCache::~GeometryCache() {}
+
+bool GeometryCache::equal(const Geometry& a, const Geometry& b) {
+  if (a.attribute() != b.attribute() || a.vertexCount() != b.vertexCount() ||
+      a.vertexSize() != b.vertexSize() || a.indexCount() != b.indexCount() ||
+      a.indexType() != b.indexType() || a.drawingMode() != b.drawingMode())
+    return false;
+  if (!a.hasData() || !b.hasData()) return a.contentHash() == b.contentHash();
+  return memcmp(a.vertexData(), b.vertexData(),
+                a.vertexCount() * a.vertexSize()) == 0 &&
+         memcmp(a.indexData(), b.indexData(),
+                a.indexCount() * Geometry::sizeOfType(a.indexType())) == 0;
+}
+
+size_t GeometryCache::byteSize(const Geometry& g) {
+  return g.vertexCount() * g.vertexSize() +
+         g.indexCount() * Geometry::sizeOfType(g.indexType());
+}
+
+std::shared_ptr<Geometry> GeometryCache::share(
+    std::unique_ptr<Geometry> geometry) {
+  // Buffers filled in ranges were never seen whole.
+  if (!geometry->hasContentHash())
+    return std::shared_ptr<Geometry>(std::move(geometry));
+
+  uint64_t h = geometry->contentHash();
+
+  QMutexLocker lock(&m_mutex);
+  auto range = m_geometry.equal_range(h);
+  for (auto it = range.first; it != range.second;) {
+    std::shared_ptr<Geometry> shared = it->second.lock();
+    if (!shared) {
+      it = m_geometry.erase(it);
+      continue;
+    }
+    if (equal(*shared, *geometry)) {
+      m_statistics.hits++;
+      m_statistics.savedBytes += byteSize(*geometry);
+      return shared;
+    }
+    ++it;
+  }
+
+  std::shared_ptr<Geometry> shared(std::move(geometry));
+  m_geometry.emplace(h, shared);
+  return shared;
+}
+
+void GeometryCache::collect() {
+  QMutexLocker lock(&m_mutex);
+  for (auto it = m_geometry.begin(); it != m_geometry.end();)
+    it = it->second.expired() ? m_geometry.erase(it) : std::next(it);
+}
+
+GeometryCache::Statistics GeometryCache::statistics() {
+  QMutexLocker lock(&m_mutex);
+  Statistics result = m_statistics;
+  result.shared = 0;
+  result.bytes = 0;
+  for (const auto& p : m_geometry)
+    if (std::shared_ptr<Geometry> g = p.second.lock()) {
+      result.shared++;
+      result.bytes += byteSize(*g);
+    }
+  return result;
+}
+}  // namespace SceneGraph
@@ -0,0 +1,49 @@
+#ifndef GEOMETRYCACHE_HPP
+#define GEOMETRYCACHE_HPP
+#include <QMutex>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace SceneGraph {
+
+class Geometry;
+
+// Geometries of a share group keyed by their content. Handing a filled and
+// uploaded geometry to share() gives back the live geometry with the same
+// attribute layout, drawing mode, vertices and indices if there is one, so
+// identical meshes keep a single buffer and CPU copy. Geometries which dropped
+// their CPU copy are matched by the content hash taken at their upload.
+// Shared geometries must not be changed afterwards.
+class GeometryCache {
+ public:
+  struct Statistics {
+    uint shared;
+    uint hits;
+    size_t bytes;
+    size_t savedBytes;
+  };
+
+ private:
+  QMutex m_mutex;
+  std::unordered_multimap<uint64_t, std::weak_ptr<Geometry>> m_geometry;
+  Statistics m_statistics;
+
+  static bool equal(const Geometry&, const Geometry&);
+  static size_t byteSize(const Geometry&);
+
+ public:
+  GeometryCache();
+  ~GeometryCache();
+
+  std::shared_ptr<Geometry> share(std::unique_ptr<Geometry>);
+
+  // Forgets geometries no longer used.
+  void collect();
+
+  Statistics statistics();
+};
+}  // namespace SceneGraph
+
+#endif  // GEOMETRYCACHE_HPP
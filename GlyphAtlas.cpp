@@ -0,0 +1,207 @@
+#include "GlyphAtlas.hpp"
+#include <QImage>
+#include <QOpenGLContext>
+#include <QPainter>
+#include <QPainterPath>
+#include <algorithm>
+#include <cmath>
+
+namespace SceneGraph {
+
+namespace {
+
+std::string glyphKey(const QRawFont& font, quint32 index) {
+  return (font.familyName() + "/" + font.styleName() + "/" +
+          QString::number(font.weight()) + "/" + QString::number(index))
+      .toStdString();
+}
+
+// Beyond any distance in a glyph, finite so the parabola intersections below
+// stay defined.
+const float FAR = 1e20f;
+
+// Squared distance along a row or column of n samples, from each one to the
+// nearest sample at zero, as the lower envelope of the parabolas rooted at
+// the samples (Felzenszwalb and Huttenlocher). Linear in n.
+void transform(float* f, int n, int stride, std::vector<float>& d,
+               std::vector<int>& v, std::vector<float>& z) {
+  auto at = [&](int q) { return f[q * stride] + float(q) * q; };
+  int k = 0;
+  v[0] = 0;
+  z[0] = -FAR;
+  z[1] = FAR;
+  for (int q = 1; q < n; q++) {
+    float s = (at(q) - at(v[k])) / float(2 * (q - v[k]));
+    while (s <= z[k]) {
+      k--;
+      s = (at(q) - at(v[k])) / float(2 * (q - v[k]));
+    }
+    k++;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = FAR;
+  }
+
+  k = 0;
+  for (int q = 0; q < n; q++) {
+    while (z[k + 1] < q) k++;
+    d[q] = float(q - v[k]) * (q - v[k]) + f[v[k] * stride];
+  }
+  for (int q = 0; q < n; q++) f[q * stride] = d[q];
+}
+
+// Squared distance of each pixel to the nearest pixel whose inside flag is
+// the given one, by a pass over the columns and then over the rows.
+std::vector<float> squaredDistance(const std::vector<bool>& inside,
+                                   bool target, int width, int height) {
+  std::vector<float> f(width * height);
+  for (size_t i = 0; i < f.size(); i++) f[i] = inside[i] == target ? 0 : FAR;
+
+  int n = std::max(width, height);
+  std::vector<float> d(n), z(n + 1);
+  std::vector<int> v(n);
+  for (int x = 0; x < width; x++) transform(&f[x], height, width, d, v, z);
+  for (int y = 0; y < height; y++) transform(&f[y * width], width, 1, d, v, z);
+  return f;
+}
+}  // namespace
+
+GlyphAtlas::GlyphAtlas() {
+  initializeOpenGLFunctions();
+
+  // Fields are sampled from the red channel, single channel formats differ
+  // between desktop and ES.
+  QOpenGLContext* context = QOpenGLContext::currentContext();
+  m_format = GL_LUMINANCE;
+#ifdef GL_RED
+  if (!context->isOpenGLES() && context->format().majorVersion() >= 3)
+    m_format = GL_RED;
+#endif
+}
+
+GlyphAtlas::~GlyphAtlas() {
+  for (const Page& page : m_page) glDeleteTextures(1, &page.texture);
+}
+
+GlyphAtlas::Glyph GlyphAtlas::glyph(const QRawFont& font, quint32 index) {
+  QMutexLocker lock(&m_mutex);
+
+  std::string key = glyphKey(font, index);
+  auto it = m_glyph.find(key);
+  if (it != m_glyph.end()) return it->second;
+
+  Glyph& glyph = m_glyph[key];
+  render(font, index, glyph);
+  return glyph;
+}
+
+uint GlyphAtlas::pageCount() const {
+  QMutexLocker lock(&m_mutex);
+  return m_page.size();
+}
+
+GLuint GlyphAtlas::texture(uint page) const {
+  QMutexLocker lock(&m_mutex);
+  return m_page[page].texture;
+}
+
+void GlyphAtlas::render(const QRawFont& f, quint32 index, Glyph& glyph) {
+  glyph = Glyph();
+
+  QRawFont font(f);
+  font.setPixelSize(GLYPH_SIZE);
+  QPainterPath path = font.pathForGlyph(index);
+  if (path.isEmpty()) return;
+
+  QRect bounds = path.boundingRect().toAlignedRect().adjusted(
+      -SPREAD, -SPREAD, SPREAD, SPREAD);
+  int width = bounds.width(), height = bounds.height();
+
+  QImage image(width, height, QImage::Format_Alpha8);
+  image.fill(Qt::transparent);
+  {
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.translate(-bounds.x(), -bounds.y());
+    painter.fillPath(path, Qt::black);
+  }
+
+  // Distance to the closest pixel on the other side of the outline, limited
+  // to the spread, from the centre of the pixel's coverage.
+  auto coverage = [&](int x, int y) {
+    return image.constScanLine(y)[x] / 255.0f;
+  };
+  std::vector<bool> inside(width * height);
+  for (int y = 0; y < height; y++)
+    for (int x = 0; x < width; x++)
+      inside[y * width + x] = coverage(x, y) >= 0.5f;
+  std::vector<float> toInside = squaredDistance(inside, true, width, height);
+  std::vector<float> toOutside = squaredDistance(inside, false, width, height);
+
+  std::vector<uchar> field(width * height);
+  for (int y = 0; y < height; y++)
+    for (int x = 0; x < width; x++) {
+      int i = y * width + x;
+      float c = coverage(x, y);
+      float best = std::min(std::sqrt(inside[i] ? toOutside[i] : toInside[i]),
+                            float(SPREAD));
+      float distance = (inside[i] ? best : -best) - 0.5f + c;
+      float value = 0.5f + distance / (2 * SPREAD);
+      field[i] = uchar(std::min(std::max(value, 0.0f), 1.0f) * 255);
+    }
+
+  QPoint p = allocate(width, height, glyph.page);
+  glBindTexture(GL_TEXTURE_2D, m_page[glyph.page].texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, p.x(), p.y(), width, height, m_format,
+                  GL_UNSIGNED_BYTE, field.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glyph.rect = QRectF(bounds);
+  glyph.texture = QRectF(qreal(p.x()) / PAGE_SIZE, qreal(p.y()) / PAGE_SIZE,
+                         qreal(width) / PAGE_SIZE, qreal(height) / PAGE_SIZE);
+}
+
+QPoint GlyphAtlas::allocate(int width, int height, uint& index) {
+  // Shelves of glyphs, left to right and then top to bottom.
+  if (!m_page.empty()) {
+    Page& page = m_page.back();
+    if (page.x + width > PAGE_SIZE) {
+      page.x = 0;
+      page.y += page.rowHeight;
+      page.rowHeight = 0;
+    }
+    if (page.y + height <= PAGE_SIZE) {
+      QPoint p(page.x, page.y);
+      page.x += width;
+      page.rowHeight = std::max(page.rowHeight, height);
+      index = m_page.size() - 1;
+      return p;
+    }
+  }
+
+  Page page = {0, width, 0, height};
+  glGenTextures(1, &page.texture);
+  glBindTexture(GL_TEXTURE_2D, page.texture);
+  std::vector<uchar> empty(PAGE_SIZE * PAGE_SIZE);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+#ifdef GL_R8
+  GLint internalFormat = m_format == GL_LUMINANCE ? GL_LUMINANCE : GL_R8;
+#else
+  GLint internalFormat = m_format;
+#endif
+  glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, PAGE_SIZE, PAGE_SIZE, 0,
+               m_format, GL_UNSIGNED_BYTE, empty.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  m_page.push_back(page);
+  index = m_page.size() - 1;
+  return QPoint(0, 0);
+}
+}  // namespace SceneGraph
@@ -0,0 +1,60 @@
+#ifndef GLYPHATLAS_HPP
+#define GLYPHATLAS_HPP
+#include <QMutex>
+#include <QOpenGLFunctions>
+#include <QRawFont>
+#include <QRectF>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SceneGraph {
+
+// Signed distance fields of glyphs packed into texture pages, shared by the
+// renderers of a share group. Glyphs are rendered at a single size which
+// scales to any other, and each new glyph is uploaded into its own part of a
+// page as it is first asked for.
+class GlyphAtlas : protected QOpenGLFunctions {
+ public:
+  // Size in pixels glyphs are rendered at, and the distance in atlas pixels
+  // the field covers on either side of the outline.
+  static const int GLYPH_SIZE = 48;
+  static const int SPREAD = 6;
+  static const int PAGE_SIZE = 1024;
+
+  struct Glyph {
+    uint page;
+    // Quad relative to the glyph origin in GLYPH_SIZE units, and its texture
+    // coordinates. Empty for glyphs without an outline.
+    QRectF rect;
+    QRectF texture;
+  };
+
+ private:
+  struct Page {
+    GLuint texture;
+    int x, y;
+    int rowHeight;
+  };
+
+  mutable QMutex m_mutex;
+  std::unordered_map<std::string, Glyph> m_glyph;
+  std::vector<Page> m_page;
+  GLenum m_format;
+
+  void render(const QRawFont&, quint32 index, Glyph&);
+  QPoint allocate(int width, int height, uint& page);
+
+ public:
+  GlyphAtlas();
+  ~GlyphAtlas();
+
+  Glyph glyph(const QRawFont&, quint32 index);
+
+  uint pageCount() const;
+  GLuint texture(uint page) const;
+};
+}  // namespace SceneGraph
+
+#endif  // GLYPHATLAS_HPP
@@ -3,6 +3,9 @@
 #include <QColor>
 #include <QOpenGLFunctions>
 #include <QOpenGLTexture>
+#include <cassert>
+#include <string>
+#include "Renderer.hpp"
 #include "Shader.hpp"
 
 namespace SceneGraph {
@@ -12,94 +15,220 @@ class Material {
   Material();
 
   virtual Shader* shader() const = 0;
+
+  // Nodes flagged UsePreprocess whose output the material samples, e.g. a
+  // ShaderSource's shaderNode(). They run before frames drawing with it.
+  virtual void inputs(std::vector<Node*>&) const {}
+};
+
+namespace Feature {
+enum : unsigned {
+  UniformColor = 1u << 0,
+  VertexColor = 1u << 1,
+  Texture = 1u << 2,
+  AlphaTest = 1u << 3,
+  PremultipliedAlpha = 1u << 4,
+  PointSize = 1u << 5,
 };
+}  // namespace Feature
 
-class ColorMaterial : public Material {
+// State shared by all permutations of FeatureShader, each permutation only
+// reads what its features use. PermutationMaterial exposes the setters of its
+// features.
+class FeatureMaterial : public Material {
  private:
   QColor m_color;
-
-  class ColorShader : public Shader, public QOpenGLFunctions {
-   private:
-    int m_matrix;
-    int m_color;
-
-   protected:
-    void initialize();
-
-    inline void activate() override {}
-    inline void deactivate() override {}
-
-    const char* vertexShader() const override;
-    const char* fragmentShader() const override;
-
-    std::vector<std::string> attribute() const override;
-
-    void updateState(const Material* m, const RenderState& state);
-  };
+  QOpenGLTexture* m_texture;
+  float m_alphaThreshold;
 
  protected:
-  inline Shader* shader() const { return Shader::get<ColorShader>(); }
+  inline void setColor(QColor c) { m_color = c; }
+  inline void setTexture(QOpenGLTexture* t) { m_texture = t; }
+  inline void setAlphaThreshold(float t) { m_alphaThreshold = t; }
 
  public:
+  FeatureMaterial();
+
   inline QColor color() const { return m_color; }
-  inline void setColor(QColor c) { m_color = c; }
+  inline QOpenGLTexture* texture() const { return m_texture; }
+  inline float alphaThreshold() const { return m_alphaThreshold; }
 };
 
-class TextureMaterial : public Material {
- private:
-  QOpenGLTexture* m_texture;
-
-  class TextureShader : public Shader, public QOpenGLFunctions {
-   private:
-    int m_matrix;
-    int m_texture;
+// Shader source concatenated at compile time, e.g. from GLSL() snippets.
+struct StaticSource {
+  static const size_t CAPACITY = 1024;
 
-   protected:
-    void initialize();
+  char text[CAPACITY];
+  size_t size;
 
-    inline void activate() override {}
-    inline void deactivate() override {}
-
-    const char* vertexShader() const override;
-    const char* fragmentShader() const override;
+  // Running past the capacity fails constant evaluation.
+  constexpr StaticSource& operator+=(const char* s) {
+    while (*s) text[size++] = *s++;
+    text[size] = 0;
+    return *this;
+  }
+};
 
-    std::vector<std::string> attribute() const override;
+// Shader specialized for a set of Feature flags. Sources are assembled at
+// compile time from the snippets selected by Features and updateState() only
+// touches uniforms of enabled features, so every permutation runs without
+// feature checks.
+template <unsigned Features>
+class FeatureShader : public Shader {
+ private:
+  int m_matrix;
+  int m_color;
+  int m_texture;
+  int m_alphaThreshold;
 
-    void updateState(const Material*, const RenderState&);
-  };
+  static constexpr bool has(unsigned feature) {
+    return (Features & feature) != 0;
+  }
 
  protected:
-  inline Shader* shader() const { return Shader::get<TextureShader>(); }
+  void initialize() override {
+    Shader::initialize();
+
+    m_matrix = program()->uniformLocation("matrix");
+    if (has(Feature::UniformColor))
+      m_color = program()->uniformLocation("uniformColor");
+    if (has(Feature::Texture))
+      m_texture = program()->uniformLocation("texture");
+    if (has(Feature::AlphaTest))
+      m_alphaThreshold = program()->uniformLocation("alphaThreshold");
+  }
+
+  // Point sizes from the shader are context state, set for each draw as the
+  // shader is shared by the contexts of a share group.
+  void activate() override {
+#ifdef GL_VERTEX_PROGRAM_POINT_SIZE
+    if (has(Feature::PointSize))
+      functions()->glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+#endif
+    if (has(Feature::PremultipliedAlpha))
+      functions()->glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  }
+
+  void deactivate() override {
+#ifdef GL_VERTEX_PROGRAM_POINT_SIZE
+    if (has(Feature::PointSize))
+      functions()->glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
+#endif
+    if (has(Feature::PremultipliedAlpha))
+      functions()->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  }
+
+  static constexpr StaticSource vertexSource() {
+    StaticSource source{};
+    source += GLSL(attribute vec4 position; uniform mat4 matrix;);
+    if (has(Feature::Texture))
+      source += GLSL(attribute vec2 tcoord; varying vec2 texcoord;);
+    if (has(Feature::VertexColor))
+      source += GLSL(attribute vec4 color; varying vec4 fcolor;);
+    source += "void main() {";
+    if (has(Feature::PointSize)) source += GLSL(gl_PointSize = 4.0;);
+    if (has(Feature::Texture)) source += GLSL(texcoord = tcoord.xy;);
+    if (has(Feature::VertexColor)) source += GLSL(fcolor = color;);
+    source += GLSL(gl_Position = matrix * position;);
+    source += "}";
+    return source;
+  }
+
+  static constexpr StaticSource fragmentSource() {
+    StaticSource source{};
+    if (has(Feature::UniformColor)) source += GLSL(uniform vec4 uniformColor;);
+    if (has(Feature::Texture))
+      source += GLSL(uniform sampler2D texture; varying vec2 texcoord;);
+    if (has(Feature::VertexColor)) source += GLSL(varying vec4 fcolor;);
+    if (has(Feature::AlphaTest)) source += GLSL(uniform float alphaThreshold;);
+    source += "void main() {";
+    source += GLSL(vec4 result = vec4(1.0););
+    if (has(Feature::Texture))
+      source += GLSL(result *= max(texture2D(texture, texcoord), vec4(0)););
+    if (has(Feature::VertexColor)) source += GLSL(result *= fcolor;);
+    if (has(Feature::UniformColor)) source += GLSL(result *= uniformColor;);
+    if (has(Feature::AlphaTest))
+      source += GLSL(if (result.a < alphaThreshold) discard;);
+    if (has(Feature::PremultipliedAlpha))
+      source += GLSL(result.rgb *= result.a;);
+    source += GLSL(gl_FragColor = result;);
+    source += "}";
+    return source;
+  }
+
+  const char* vertexShader() const override {
+    static constexpr StaticSource source = vertexSource();
+    return source.text;
+  }
+
+  const char* fragmentShader() const override {
+    static constexpr StaticSource source = fragmentSource();
+    return source.text;
+  }
+
+  std::vector<std::string> attribute() const override {
+    std::vector<std::string> result = {"position"};
+    if (has(Feature::Texture)) result.push_back("tcoord");
+    if (has(Feature::VertexColor)) result.push_back("color");
+    return result;
+  }
+
+  void updateState(const Material* m, const RenderState& state) override {
+    const FeatureMaterial* material = static_cast<const FeatureMaterial*>(m);
+
+    program()->setUniformValue(m_matrix, state.matrix());
+    if (has(Feature::UniformColor))
+      program()->setUniformValue(m_color, material->color());
+    if (has(Feature::Texture)) {
+      assert(material->texture());
+      functions()->glActiveTexture(GL_TEXTURE0);
+      functions()->glBindTexture(GL_TEXTURE_2D,
+                                 material->texture()->textureId());
+      program()->setUniformValue(m_texture, 0);
+    }
+    if (has(Feature::AlphaTest))
+      program()->setUniformValue(m_alphaThreshold,
+                                 material->alphaThreshold());
+  }
 
  public:
-  TextureMaterial();
-
-  inline QOpenGLTexture* texture() const { return m_texture; }
-  inline void setTexture(QOpenGLTexture* t) { m_texture = t; }
+  FeatureShader()
+      : m_matrix(-1), m_color(-1), m_texture(-1), m_alphaThreshold(-1) {}
 };
 
-class VertexColorMaterial : public Material {
- private:
-  class VertexColorShader : public Shader {
-   private:
-    int m_matrix;
-
-   protected:
-    void initialize();
-
-    inline void activate() override {}
-    inline void deactivate() override {}
-
-    const char* vertexShader() const override;
-    const char* fragmentShader() const override;
+// Setters of features the permutation doesn't have fail to compile.
+template <unsigned Features>
+class PermutationMaterial : public FeatureMaterial {
+ public:
+  inline Shader* shader() const override {
+    return Shader::get<FeatureShader<Features>>();
+  }
+
+  inline void setColor(QColor c) {
+    static_assert(Features & Feature::UniformColor,
+                  "The material has no uniform color");
+    FeatureMaterial::setColor(c);
+  }
+
+  inline void setTexture(QOpenGLTexture* t) {
+    static_assert(Features & Feature::Texture, "The material has no texture");
+    FeatureMaterial::setTexture(t);
+  }
+
+  inline void setAlphaThreshold(float t) {
+    static_assert(Features & Feature::AlphaTest,
+                  "The material has no alpha test");
+    FeatureMaterial::setAlphaThreshold(t);
+  }
+};
 
-    std::vector<std::string> attribute() const override;
+class ColorMaterial
+    : public PermutationMaterial<Feature::UniformColor | Feature::PointSize> {
+};
 
-    void updateState(const Material*, const RenderState&);
-  };
+class TextureMaterial : public PermutationMaterial<Feature::Texture> {};
 
- protected:
-  inline Shader* shader() const { return Shader::get<VertexColorShader>(); }
+class VertexColorMaterial : public PermutationMaterial<Feature::VertexColor> {
 };
 }  // namespace SceneGraph
 
@@ -0,0 +1,316 @@
+#include "MeshFile.hpp"
+#include <QDebug>
+#include <QSaveFile>
+#include <QtConcurrent>
+#include <cassert>
+#include <cfloat>
+#include <cstring>
+#include <limits>
+#include "VertexFormat.hpp"
+
+namespace SceneGraph {
+
+namespace {
+
+const char MAGIC[4] = {'S', 'G', 'M', 'B'};
+const uint BLOCK_ALIGNMENT = 16;
+const uint PAGE_SIZE = 4096;
+
+uint64_t align(uint64_t offset) {
+  return (offset + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+}
+
+// Whether size bytes starting at offset lie within end, without wrapping.
+bool contains(uint64_t end, uint64_t offset, uint64_t size) {
+  return offset <= end && size <= end - offset;
+}
+
+bool isIndexType(uint32_t type) {
+  return type == GL_UNSIGNED_BYTE || type == GL_UNSIGNED_SHORT ||
+         type == GL_UNSIGNED_INT;
+}
+
+bool isAttributeType(int32_t type) {
+  return type == GL_FLOAT || type == GL_BYTE || type == GL_UNSIGNED_BYTE ||
+         type == GL_SHORT || type == GL_UNSIGNED_SHORT || type == GL_INT ||
+         type == GL_UNSIGNED_INT || type == VertexFormat::HALF_FLOAT ||
+         type == VertexFormat::HALF_FLOAT_OES || VertexFormat::isPacked(type);
+}
+}  // namespace
+
+MeshFile::MeshFile() : m_data(), m_map(), m_header() {}
+
+MeshFile::~MeshFile() { close(); }
+
+bool MeshFile::open(const QString& path) {
+  close();
+
+  m_file.setFileName(path);
+  if (!m_file.open(QIODevice::ReadOnly)) {
+    qDebug() << "[FAIL] Couldn't open mesh" << path;
+    return false;
+  }
+
+  qint64 size = m_file.size();
+  m_map = m_file.map(0, size);
+  if (m_map) {
+    m_data = m_map;
+  } else {
+    m_buffer = m_file.readAll();
+    m_data = reinterpret_cast<const uchar*>(m_buffer.constData());
+  }
+
+  const Header* header = reinterpret_cast<const Header*>(m_data);
+  const AttributeRecord* record =
+      reinterpret_cast<const AttributeRecord*>(m_data + sizeof(Header));
+  // Everything in the header comes from the file, so it is checked before
+  // it is used for sizes or handed to GL.
+  auto valid = [&] {
+    if (size < qint64(sizeof(Header)) ||
+        memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header->version != VERSION || header->drawingMode > GL_TRIANGLE_FAN)
+      return false;
+    if (header->indexCount && !isIndexType(header->indexType)) return false;
+    if (header->vertexOffset % BLOCK_ALIGNMENT ||
+        header->indexOffset % BLOCK_ALIGNMENT)
+      return false;
+
+    // Blocks also have to fit a GL buffer and the address space.
+    uint64_t end = std::min<uint64_t>(
+        uint64_t(size), uint64_t(std::numeric_limits<GLsizeiptr>::max()));
+    if (!contains(end, sizeof(Header),
+                  uint64_t(header->attributeCount) * sizeof(AttributeRecord)))
+      return false;
+    if (!contains(end, header->vertexOffset,
+                  uint64_t(header->vertexCount) * header->vertexSize))
+      return false;
+    if (header->indexCount &&
+        !contains(end, header->indexOffset,
+                  uint64_t(header->indexCount) *
+                      Geometry::sizeOfType(header->indexType)))
+      return false;
+
+    // Attributes have to be of known types and lie within the vertex.
+    uint64_t offset = 0;
+    for (uint i = 0; i < header->attributeCount; i++) {
+      const AttributeRecord& r = record[i];
+      if (!isAttributeType(r.primitiveType) || r.tupleSize < 1 ||
+          r.tupleSize > 4 ||
+          (VertexFormat::isPacked(r.primitiveType) && r.tupleSize != 4))
+        return false;
+      if (r.offset >= 0) offset = uint64_t(r.offset);
+      offset += Geometry::sizeOfAttribute({r.tupleSize, r.primitiveType});
+      if (offset > header->vertexSize) return false;
+    }
+    return true;
+  };
+  if (!valid()) {
+    qDebug() << "[FAIL] Invalid mesh" << path;
+    close();
+    return false;
+  }
+
+  for (uint i = 0; i < header->attributeCount; i++)
+    m_attribute.push_back({record[i].tupleSize, record[i].primitiveType,
+                           record[i].normalized != 0, record[i].offset});
+
+  m_header = header;
+  return true;
+}
+
+void MeshFile::close() {
+  if (m_map) m_file.unmap(m_map);
+  if (m_file.isOpen()) m_file.close();
+  m_buffer = QByteArray();
+  m_data = m_map = nullptr;
+  m_header = nullptr;
+  m_attribute.clear();
+}
+
+QFuture<std::shared_ptr<MeshFile>> MeshFile::openAsync(const QString& path) {
+  return QtConcurrent::run([path] {
+    auto file = std::make_shared<MeshFile>();
+    if (!file->open(path)) return std::shared_ptr<MeshFile>();
+
+    // Faults the mapping in here rather than during the upload.
+    const Header& h = file->header();
+    const volatile uchar* data = file->m_data;
+    uint64_t end = h.vertexOffset + uint64_t(h.vertexCount) * h.vertexSize;
+    if (h.indexCount)
+      end = std::max(end, h.indexOffset + uint64_t(h.indexCount) *
+                                              Geometry::sizeOfType(
+                                                  h.indexType));
+    uchar sum = 0;
+    for (uint64_t i = 0; i < end; i += PAGE_SIZE) sum += data[i];
+    (void)sum;
+    return file;
+  });
+}
+
+BoundingBox MeshFile::boundingBox() const {
+  if (m_header->boundsMin[0] > m_header->boundsMax[0])
+    return BoundingBox::infinite();
+  return BoundingBox(
+      QVector3D(m_header->boundsMin[0], m_header->boundsMin[1],
+                m_header->boundsMin[2]),
+      QVector3D(m_header->boundsMax[0], m_header->boundsMax[1],
+                m_header->boundsMax[2]));
+}
+
+std::unique_ptr<Geometry> MeshFile::createGeometry() const {
+  assert(isOpen());
+  const Header& h = header();
+
+  auto geometry = std::make_unique<Geometry>(
+      m_attribute, 0, h.vertexSize, 0,
+      h.indexCount ? h.indexType : GL_UNSIGNED_INT);
+  geometry->setVertexCount(h.vertexCount);
+  geometry->setIndexCount(h.indexCount);
+  geometry->setDrawingMode(h.drawingMode);
+  geometry->setBoundingBox(boundingBox());
+  geometry->updateVertexData(vertexData(),
+                             h.indexCount ? indexData() : nullptr);
+
+  QString path = m_file.fileName();
+  geometry->setRetention(Geometry::Retention::Reload);
+  geometry->setLoader([path](Geometry* g) {
+    MeshFile file;
+    if (!file.open(path)) return;
+    const Header& h = file.header();
+    memcpy(g->vertexData(), file.vertexData(),
+           std::min(g->vertexCount(), h.vertexCount) * g->vertexSize());
+    if (g->indexCount())
+      memcpy(g->indexData(), file.indexData(),
+             std::min(g->indexCount(), h.indexCount) *
+                 Geometry::sizeOfType(g->indexType()));
+  });
+  return geometry;
+}
+
+bool MeshFile::write(const QString& path, const Mesh& mesh) {
+  Header header = {};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.attributeCount = mesh.attribute.size();
+  header.vertexCount = mesh.vertexCount;
+  header.vertexSize = mesh.vertexSize;
+  header.indexCount = mesh.indexCount;
+  header.indexType = mesh.indexType;
+  header.drawingMode = mesh.drawingMode;
+
+  BoundingBox box;
+  if (!mesh.attribute.empty() &&
+      mesh.attribute[0].primitiveType == GL_FLOAT &&
+      mesh.attribute[0].tupleSize <= 4 && mesh.vertexCount) {
+    uint offset = mesh.attribute[0].offset > 0 ? mesh.attribute[0].offset : 0;
+    box = BoundingBox::fromPoints(
+        static_cast<const char*>(mesh.vertexData) + offset,
+        size_t(mesh.vertexCount) * mesh.vertexSize - offset, mesh.vertexCount,
+        mesh.vertexSize, mesh.attribute[0].tupleSize);
+  }
+  // Meshes without float positions get no bounds, written as an inverted
+  // box.
+  for (int i = 0; i < 3; i++) {
+    header.boundsMin[i] = box.isEmpty() ? FLT_MAX : box.min()[i];
+    header.boundsMax[i] = box.isEmpty() ? -FLT_MAX : box.max()[i];
+  }
+
+  uint64_t vertexBytes = uint64_t(mesh.vertexCount) * mesh.vertexSize;
+  uint64_t indexBytes =
+      mesh.indexCount ? uint64_t(mesh.indexCount) *
+                            Geometry::sizeOfType(mesh.indexType)
+                      : 0;
+  header.vertexOffset = align(sizeof(Header) + header.attributeCount *
+                                                   sizeof(AttributeRecord));
+  header.indexOffset = align(header.vertexOffset + vertexBytes);
+
+  std::vector<AttributeRecord> record;
+  for (const Attribute& a : mesh.attribute)
+    record.push_back({a.tupleSize, a.primitiveType, a.normalized, a.offset});
+
+  // Written block by block, as the whole file may be larger than a
+  // QByteArray can hold.
+  QSaveFile file(path);
+  uint64_t position = 0;
+  auto put = [&](uint64_t offset, const void* data, uint64_t size) {
+    const char padding[BLOCK_ALIGNMENT] = {};
+    assert(offset >= position && offset - position <= BLOCK_ALIGNMENT);
+    qint64 gap = qint64(offset - position);
+    if (gap && file.write(padding, gap) != gap) return false;
+    position = offset + size;
+    return !size || file.write(static_cast<const char*>(data),
+                               qint64(size)) == qint64(size);
+  };
+  if (!file.open(QIODevice::WriteOnly) ||
+      !put(0, &header, sizeof(header)) ||
+      !put(sizeof(Header), record.data(),
+           record.size() * sizeof(AttributeRecord)) ||
+      !put(header.vertexOffset, mesh.vertexData, vertexBytes) ||
+      !put(header.indexOffset, mesh.indexData, indexBytes) ||
+      !file.commit()) {
+    qDebug() << "[FAIL] Couldn't write mesh" << path;
+    return false;
+  }
+  return true;
+}
+
+bool MeshFile::write(const QString& path, const Geometry& geometry) {
+  assert(geometry.hasData());
+  return write(path, {geometry.attribute(), geometry.vertexSize(),
+                      geometry.vertexCount(), geometry.vertexData(),
+                      geometry.indexCount(), geometry.indexType(),
+                      geometry.indexData(), geometry.drawingMode()});
+}
+
+MeshStream::MeshStream(std::shared_ptr<MeshFile> file)
+    : m_file(std::move(file)), m_vertexUploaded(), m_indexUploaded() {
+  assert(m_file && m_file->isOpen());
+  const MeshFile::Header& h = m_file->header();
+
+  m_geometry = std::make_unique<Geometry>(
+      m_file->attribute(), 0, h.vertexSize, 0,
+      h.indexCount ? h.indexType : GL_UNSIGNED_INT);
+  m_geometry->setVertexCount(h.vertexCount);
+  m_geometry->setIndexCount(h.indexCount);
+  m_geometry->setDrawingMode(h.drawingMode);
+  m_geometry->setBoundingBox(m_file->boundingBox());
+  m_geometry->allocateBuffers();
+}
+
+bool MeshStream::upload(uint budget) {
+  if (finished()) return true;
+
+  const MeshFile::Header& h = m_file->header();
+  uint64_t vertexBytes = uint64_t(h.vertexCount) * h.vertexSize;
+  uint64_t indexBytes =
+      h.indexCount ? uint64_t(h.indexCount) * Geometry::sizeOfType(h.indexType)
+                   : 0;
+
+  uint64_t size = std::min<uint64_t>(budget, vertexBytes - m_vertexUploaded);
+  if (size) {
+    m_geometry->updateVertexRange(
+        m_vertexUploaded, size,
+        static_cast<const char*>(m_file->vertexData()) + m_vertexUploaded);
+    m_vertexUploaded += size;
+    budget -= size;
+  }
+
+  size = std::min<uint64_t>(budget, indexBytes - m_indexUploaded);
+  if (size) {
+    m_geometry->updateIndexRange(
+        m_indexUploaded, size,
+        static_cast<const char*>(m_file->indexData()) + m_indexUploaded);
+    m_indexUploaded += size;
+  }
+
+  if (m_vertexUploaded < vertexBytes || m_indexUploaded < indexBytes)
+    return false;
+  m_file = nullptr;
+  return true;
+}
+
+std::unique_ptr<Geometry> MeshStream::takeGeometry() {
+  assert(finished());
+  return std::move(m_geometry);
+}
+}  // namespace SceneGraph
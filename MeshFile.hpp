@@ -0,0 +1,116 @@
+#ifndef MESHFILE_HPP
+#define MESHFILE_HPP
+#include <QFile>
+#include <QFuture>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "BoundingBox.hpp"
+#include "Geometry.hpp"
+
+namespace SceneGraph {
+
+// Binary mesh whose vertex and index blocks are laid out the way Geometry
+// uploads them. The file is memory mapped and uploaded straight from the
+// mapping. Little endian: a header, the attribute records, then the vertex
+// and index blocks at 16 byte aligned offsets.
+class MeshFile {
+ public:
+  static const uint32_t VERSION = 1;
+
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t attributeCount;
+    uint32_t vertexCount;
+    uint32_t vertexSize;
+    uint32_t indexCount;
+    uint32_t indexType;
+    uint32_t drawingMode;
+    // Inverted, min above max, for meshes without float positions.
+    float boundsMin[3];
+    float boundsMax[3];
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+  };
+
+  struct AttributeRecord {
+    int32_t tupleSize;
+    int32_t primitiveType;
+    int32_t normalized;
+    int32_t offset;
+  };
+
+  // Everything written to a file.
+  struct Mesh {
+    std::vector<Attribute> attribute;
+    uint vertexSize;
+    uint vertexCount;
+    const void* vertexData;
+    uint indexCount;
+    uint indexType;
+    const void* indexData;
+    uint drawingMode;
+  };
+
+ private:
+  QFile m_file;
+  const uchar* m_data;
+  uchar* m_map;
+  QByteArray m_buffer;
+  const Header* m_header;
+  std::vector<Attribute> m_attribute;
+
+ public:
+  MeshFile();
+  ~MeshFile();
+
+  // Falls back to reading the file when it cannot be mapped.
+  bool open(const QString& path);
+  void close();
+  inline bool isOpen() const { return m_header; }
+
+  // Opens and pages in the file on the global thread pool.
+  static QFuture<std::shared_ptr<MeshFile>> openAsync(const QString& path);
+
+  inline const Header& header() const { return *m_header; }
+  inline const std::vector<Attribute>& attribute() const { return m_attribute; }
+  inline const void* vertexData() const {
+    return m_data + m_header->vertexOffset;
+  }
+  inline const void* indexData() const {
+    return m_data + m_header->indexOffset;
+  }
+  // Infinite for meshes without bounds.
+  BoundingBox boundingBox() const;
+
+  // Geometry uploaded from the mapping, without a CPU copy. Its data can be
+  // brought back with Geometry::materialize(), which reads the file again.
+  std::unique_ptr<Geometry> createGeometry() const;
+
+  static bool write(const QString& path, const Mesh&);
+  // Needs the CPU copy of the geometry.
+  static bool write(const QString& path, const Geometry&);
+};
+
+// Uploads a mesh into a geometry a bounded number of bytes at a time, so a
+// large mesh can be spread over several frames.
+class MeshStream {
+ private:
+  std::shared_ptr<MeshFile> m_file;
+  std::unique_ptr<Geometry> m_geometry;
+  uint64_t m_vertexUploaded;
+  uint64_t m_indexUploaded;
+
+ public:
+  explicit MeshStream(std::shared_ptr<MeshFile>);
+
+  // Returns whether the whole mesh is uploaded.
+  bool upload(uint budget);
+  inline bool finished() const { return !m_file; }
+
+  std::unique_ptr<Geometry> takeGeometry();
+};
+}  // namespace SceneGraph
+
+#endif  // MESHFILE_HPP
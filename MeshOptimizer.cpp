@@ -0,0 +1,303 @@
+#include "MeshOptimizer.hpp"
+#include <QVector3D>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+namespace SceneGraph {
+
+namespace {
+
+// Vertex scores after Tom Forsyth's linear-speed vertex cache optimization.
+const int CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+float vertexScore(int cachePosition, uint remaining) {
+  if (remaining == 0) return -1;
+
+  float score = 0;
+  if (cachePosition >= 0) {
+    if (cachePosition < 3)
+      score = LAST_TRIANGLE_SCORE;
+    else
+      score = std::pow(1 - float(cachePosition - 3) / (CACHE_SIZE - 3),
+                       CACHE_DECAY_POWER);
+  }
+  return score +
+         VALENCE_BOOST_SCALE * std::pow(float(remaining), -VALENCE_BOOST_POWER);
+}
+
+void weld(MeshOptimizer::Mesh& mesh) {
+  uint count = mesh.vertex.size() / mesh.vertexSize;
+  std::unordered_map<std::string, uint32_t> first;
+  std::vector<uint32_t> remap(count);
+  for (uint i = 0; i < count; i++) {
+    std::string key(&mesh.vertex[i * mesh.vertexSize], mesh.vertexSize);
+    remap[i] = first.emplace(key, i).first->second;
+  }
+  for (uint32_t& i : mesh.index) i = remap[i];
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& index, uint vertexCount) {
+  uint triangleCount = index.size() / 3;
+  std::vector<uint> remaining(vertexCount), offset(vertexCount + 1);
+  for (uint32_t i : index) remaining[i]++;
+  for (uint v = 0; v < vertexCount; v++)
+    offset[v + 1] = offset[v] + remaining[v];
+
+  // Triangles using each vertex.
+  std::vector<uint> triangles(index.size()), fill(offset.begin(), offset.end() - 1);
+  for (uint t = 0; t < triangleCount; t++)
+    for (int k = 0; k < 3; k++) triangles[fill[index[3 * t + k]]++] = t;
+
+  std::vector<int> cachePosition(vertexCount, -1);
+  std::vector<float> score(vertexCount);
+  for (uint v = 0; v < vertexCount; v++) score[v] = vertexScore(-1, remaining[v]);
+  std::vector<float> triangleScore(triangleCount);
+  for (uint t = 0; t < triangleCount; t++)
+    triangleScore[t] = score[index[3 * t]] + score[index[3 * t + 1]] +
+                       score[index[3 * t + 2]];
+
+  std::vector<bool> added(triangleCount);
+  std::vector<uint32_t> result;
+  result.reserve(index.size());
+  std::vector<uint32_t> cache;
+  uint nextUnadded = 0;
+
+  for (uint n = 0; n < triangleCount; n++) {
+    // Best triangle touching the cache, or the next one not drawn yet.
+    int best = -1;
+    float bestScore = -1;
+    for (uint32_t v : cache)
+      for (uint i = offset[v]; i < offset[v + 1]; i++) {
+        uint t = triangles[i];
+        if (!added[t] && triangleScore[t] > bestScore) {
+          bestScore = triangleScore[t];
+          best = int(t);
+        }
+      }
+    if (best < 0) {
+      while (added[nextUnadded]) nextUnadded++;
+      best = int(nextUnadded);
+    }
+
+    added[best] = true;
+    std::vector<uint32_t> updated = cache;
+    for (int k = 2; k >= 0; k--) {
+      uint32_t v = index[3 * best + k];
+      result.push_back(v);
+      remaining[v]--;
+      updated.erase(std::remove(updated.begin(), updated.end(), v),
+                    updated.end());
+      updated.insert(updated.begin(), v);
+    }
+    std::reverse(result.end() - 3, result.end());
+
+    // Vertices pushed out of the cache lose their position score.
+    for (size_t i = 0; i < updated.size(); i++) {
+      uint32_t v = updated[i];
+      cachePosition[v] = i < CACHE_SIZE ? int(i) : -1;
+      score[v] = vertexScore(cachePosition[v], remaining[v]);
+    }
+    if (updated.size() > CACHE_SIZE) updated.resize(CACHE_SIZE);
+    for (uint32_t v : cache)
+      if (cachePosition[v] < 0) score[v] = vertexScore(-1, remaining[v]);
+
+    for (uint32_t v : updated)
+      for (uint i = offset[v]; i < offset[v + 1]; i++) {
+        uint t = triangles[i];
+        if (!added[t])
+          triangleScore[t] = score[index[3 * t]] + score[index[3 * t + 1]] +
+                             score[index[3 * t + 2]];
+      }
+    cache = std::move(updated);
+  }
+
+  index = std::move(result);
+}
+
+QVector3D position(const MeshOptimizer::Mesh& mesh, uint32_t v) {
+  float p[3] = {};
+  memcpy(p, &mesh.vertex[v * mesh.vertexSize + mesh.positionOffset],
+         std::min(mesh.positionSize, 3u) * sizeof(float));
+  return QVector3D(p[0], p[1], p[2]);
+}
+
+// Splits the cache ordered triangles where the simulated cache starts over,
+// and draws the clusters facing away from the center of the mesh first,
+// which for mostly convex meshes puts near surfaces ahead of far ones.
+void optimizeOverdraw(MeshOptimizer::Mesh& mesh, uint cacheSize) {
+  std::vector<uint32_t>& index = mesh.index;
+  uint triangleCount = index.size() / 3;
+  if (triangleCount == 0 || mesh.positionSize < 3) return;
+
+  std::vector<uint> cluster = {0};
+  std::deque<uint32_t> cache;
+  for (uint t = 0; t < triangleCount; t++) {
+    uint misses = 0;
+    for (int k = 0; k < 3; k++) {
+      uint32_t v = index[3 * t + k];
+      if (std::find(cache.begin(), cache.end(), v) != cache.end()) continue;
+      misses++;
+      cache.push_back(v);
+      if (cache.size() > cacheSize) cache.pop_front();
+    }
+    if (misses == 3 && t > cluster.back()) cluster.push_back(t);
+  }
+  cluster.push_back(triangleCount);
+
+  QVector3D center;
+  for (uint32_t v : index) center += position(mesh, v);
+  center /= float(index.size());
+
+  struct Cluster {
+    uint begin, end;
+    float sort;
+  };
+  std::vector<Cluster> order;
+  for (size_t c = 0; c + 1 < cluster.size(); c++) {
+    QVector3D centroid, normal;
+    for (uint t = cluster[c]; t < cluster[c + 1]; t++) {
+      QVector3D a = position(mesh, index[3 * t]),
+                b = position(mesh, index[3 * t + 1]),
+                p = position(mesh, index[3 * t + 2]);
+      QVector3D n = QVector3D::crossProduct(b - a, p - a);
+      centroid += (a + b + p) * (n.length() / 3);
+      normal += n;
+    }
+    float area = normal.length();
+    if (area > 0) centroid /= area;
+    order.push_back({cluster[c], cluster[c + 1],
+                     QVector3D::dotProduct(centroid - center,
+                                           normal.normalized())});
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [](const Cluster& a, const Cluster& b) {
+                     return a.sort > b.sort;
+                   });
+
+  std::vector<uint32_t> result;
+  result.reserve(index.size());
+  for (const Cluster& c : order)
+    result.insert(result.end(), index.begin() + 3 * c.begin,
+                  index.begin() + 3 * c.end);
+  index = std::move(result);
+}
+
+// Renumbers vertices by first use, dropping unused ones.
+void optimizeVertexFetch(MeshOptimizer::Mesh& mesh) {
+  uint count = mesh.vertex.size() / mesh.vertexSize;
+  std::vector<uint32_t> remap(count, UINT32_MAX);
+  std::vector<char> vertex;
+  vertex.reserve(mesh.vertex.size());
+  uint32_t next = 0;
+  for (uint32_t& i : mesh.index) {
+    if (remap[i] == UINT32_MAX) {
+      remap[i] = next++;
+      vertex.insert(vertex.end(), mesh.vertex.begin() + i * mesh.vertexSize,
+                    mesh.vertex.begin() + (i + 1) * mesh.vertexSize);
+    }
+    i = remap[i];
+  }
+  mesh.vertex = std::move(vertex);
+}
+
+size_t byteSize(const MeshOptimizer::Mesh& mesh) {
+  return mesh.vertex.size() + mesh.index.size() * mesh.indexSize;
+}
+}  // namespace
+
+float MeshOptimizer::acmr(const std::vector<uint32_t>& index, uint cacheSize) {
+  if (index.size() < 3) return 0;
+
+  std::deque<uint32_t> cache;
+  uint misses = 0;
+  for (uint32_t v : index) {
+    if (std::find(cache.begin(), cache.end(), v) != cache.end()) continue;
+    misses++;
+    cache.push_back(v);
+    if (cache.size() > cacheSize) cache.pop_front();
+  }
+  return float(misses) / (index.size() / 3);
+}
+
+MeshOptimizer::Statistics MeshOptimizer::optimize(Mesh& mesh,
+                                                  const Options& options) {
+  Statistics s = {};
+  s.vertexCount[0] = mesh.vertex.size() / mesh.vertexSize;
+  s.triangleCount = mesh.index.size() / 3;
+  s.acmr[0] = acmr(mesh.index, options.cacheSize);
+  s.indexSize[0] = mesh.indexSize;
+  s.bytes[0] = byteSize(mesh);
+
+  if (options.weld) weld(mesh);
+  if (options.vertexCache)
+    optimizeVertexCache(mesh.index, mesh.vertex.size() / mesh.vertexSize);
+  if (options.overdraw) optimizeOverdraw(mesh, options.cacheSize);
+  if (options.vertexFetch || options.weld) optimizeVertexFetch(mesh);
+
+  // Byte indices are slow on most GPUs, they are written out as 16 bit.
+  uint vertexCount = mesh.vertex.size() / mesh.vertexSize;
+  if (mesh.indexSize == 1 || (options.shortIndices && vertexCount <= 0xFFFF))
+    mesh.indexSize = 2;
+
+  s.vertexCount[1] = vertexCount;
+  s.acmr[1] = acmr(mesh.index, options.cacheSize);
+  s.indexSize[1] = mesh.indexSize;
+  s.bytes[1] = byteSize(mesh);
+  return s;
+}
+
+MeshOptimizer::Statistics MeshOptimizer::optimize(Geometry* geometry,
+                                                  const Options& options) {
+  assert(geometry->hasData() && geometry->drawingMode() == GL_TRIANGLES);
+
+  Mesh mesh;
+  mesh.vertexSize = geometry->vertexSize();
+  mesh.positionOffset = geometry->attributeOffset(0);
+  mesh.positionSize = geometry->attribute()[0].primitiveType == GL_FLOAT
+                          ? geometry->attribute()[0].tupleSize
+                          : 0;
+  const char* vertex = geometry->vertexData<char>();
+  mesh.vertex.assign(vertex,
+                     vertex + geometry->vertexCount() * geometry->vertexSize());
+
+  if (geometry->indexCount()) {
+    mesh.indexSize = Geometry::sizeOfType(geometry->indexType());
+    for (uint i = 0; i < geometry->indexCount(); i++)
+      mesh.index.push_back(
+          geometry->indexType() == GL_UNSIGNED_SHORT
+              ? geometry->indexData<GLushort>()[i]
+              : geometry->indexType() == GL_UNSIGNED_BYTE
+                    ? geometry->indexData<GLubyte>()[i]
+                    : geometry->indexData<GLuint>()[i]);
+  } else {
+    mesh.indexSize = 4;
+    for (uint i = 0; i < geometry->vertexCount(); i++) mesh.index.push_back(i);
+  }
+
+  Statistics s = optimize(mesh, options);
+
+  uint vertexCount = mesh.vertex.size() / mesh.vertexSize;
+  geometry->setIndexType(mesh.indexSize == 2 ? GL_UNSIGNED_SHORT
+                                             : GL_UNSIGNED_INT);
+  geometry->allocate(vertexCount, mesh.index.size());
+  std::copy(mesh.vertex.begin(), mesh.vertex.end(),
+            geometry->vertexData<char>());
+  if (mesh.indexSize == 2)
+    std::copy(mesh.index.begin(), mesh.index.end(),
+              geometry->indexData<GLushort>());
+  else
+    std::copy(mesh.index.begin(), mesh.index.end(),
+              geometry->indexData<GLuint>());
+  geometry->updateVertexData();
+  return s;
+}
+}  // namespace SceneGraph
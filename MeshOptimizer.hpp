@@ -0,0 +1,62 @@
+#ifndef MESHOPTIMIZER_HPP
+#define MESHOPTIMIZER_HPP
+#include <cstdint>
+#include <vector>
+#include "Geometry.hpp"
+
+namespace SceneGraph {
+
+// Reorders indexed triangle lists for the GPU: welds identical vertices,
+// orders triangles for post-transform vertex cache hits and then clusters of
+// them front to back to cut overdraw, renumbers vertices in the order they
+// are first used, and picks 16 bit indices when they can address all
+// vertices. Works on raw data for offline tools and on geometries holding
+// their CPU copy at runtime.
+class MeshOptimizer {
+ public:
+  struct Options {
+    bool weld = true;
+    bool vertexCache = true;
+    bool overdraw = true;
+    bool vertexFetch = true;
+    bool shortIndices = true;
+    // Entries of the simulated cache statistics are measured with.
+    uint cacheSize = 16;
+  };
+
+  struct Statistics {
+    uint vertexCount[2];
+    uint triangleCount;
+    // Average cache misses per triangle, before and after.
+    float acmr[2];
+    uint indexSize[2];
+    size_t bytes[2];
+  };
+
+  // Triangles of a mesh whose first attribute holds float positions at
+  // positionOffset, with at least three components for the overdraw pass.
+  struct Mesh {
+    std::vector<char> vertex;
+    uint vertexSize;
+    uint positionOffset;
+    uint positionSize;
+    std::vector<uint32_t> index;
+    // Bytes per index as stored, 2 or 4 after optimizing.
+    uint indexSize;
+  };
+
+  static Statistics optimize(Mesh&, const Options&);
+  static inline Statistics optimize(Mesh& m) { return optimize(m, Options()); }
+
+  // Triangle lists only, the geometry has to hold its data. Uploads the
+  // result.
+  static Statistics optimize(Geometry*, const Options&);
+  static inline Statistics optimize(Geometry* g) {
+    return optimize(g, Options());
+  }
+
+  static float acmr(const std::vector<uint32_t>& index, uint cacheSize);
+};
+}  // namespace SceneGraph
+
+#endif  // MESHOPTIMIZER_HPP
@@ -1,13 +1,24 @@
 #include "Node.hpp"
+#include <algorithm>
+#include "Geometry.hpp"
 #include "Renderer.hpp"
 
 namespace SceneGraph {
 
 Node::Node(Node* parent, Type type)
-    : BaseObject(parent), m_renderer(), m_type(type), m_flag() {}
+    : BaseObject(parent), m_renderer(), m_type(type), m_flag(), m_changeSerial() {
+  if (parent) {
+    parent->invalidateBounds();
+    parent->markChanged();
+  }
+}
 
 Node::~Node() {
   if (renderer()) renderer()->nodeDestroyed(this);
+  if (parent()) {
+    parent()->invalidateBounds();
+    parent()->markChanged();
+  }
 }
 
 Node* Node::firstChild() const {
@@ -21,17 +32,26 @@ Node* Node::parent() const { return static_cast<Node*>(BaseObject::parent()); }
 void Node::appendChild(Node* node) {
   node->setRenderer(renderer());
   BaseObject::appendChild(node);
+  invalidateBounds();
+  markChanged();
 }
 
 void Node::removeChild(Node* node) {
   node->setRenderer(nullptr);
   BaseObject::removeChild(node);
+  invalidateBounds();
+  markChanged();
 }
 
 void Node::setFlag(Flag f) {
+  bool registered = m_flag & UsePreprocess;
   m_flag = f;
+  if (!m_renderer || registered == bool(f & UsePreprocess)) return;
 
-  if (renderer() && (f & UsePreprocess)) renderer()->m_preprocess.insert(this);
+  if (registered)
+    m_renderer->removePreprocessNode(this);
+  else
+    m_renderer->addPreprocessNode(this);
 }
 
 void Node::setRenderer(Renderer* r) {
@@ -40,18 +60,167 @@ void Node::setRenderer(Renderer* r) {
   if (m_renderer) m_renderer->nodeDestroyed(this);
 
   m_renderer = r;
-
-  if (m_renderer) m_renderer->nodeAdded(this);
+  if (r && (m_flag & UsePreprocess)) r->addPreprocessNode(this);
 
   for (Node* node = firstChild(); node; node = node->next())
     node->setRenderer(r);
 }
 
+void Node::prepare(std::vector<Node*>&) {}
+
 void Node::preprocess() {}
 
+void Node::releaseOutput() {}
+
+bool Node::transientOutput() const { return false; }
+
+BoundingBox Node::boundingBox() const {
+  BoundingBox box;
+  uint count;
+  updateBounds(box, count);
+  return box;
+}
+
+uint Node::geometryCount() const {
+  BoundingBox box;
+  uint count;
+  updateBounds(box, count);
+  return count;
+}
+
+void Node::updateBounds(BoundingBox& box, uint& count) const {
+  const TransformNode* transform = type() == Type::TransformNode
+                                       ? static_cast<const TransformNode*>(this)
+                                       : nullptr;
+  if (transform && !transform->m_boundsDirty) {
+    box = transform->m_bounds;
+    count = transform->m_geometryCount;
+    return;
+  }
+
+  box = BoundingBox();
+  count = 0;
+  if (type() == Type::GeometryNode) {
+    Geometry* geometry = static_cast<const GeometryNode*>(this)->geometry();
+    if (geometry) box = geometry->boundingBox();
+    count++;
+  }
+
+  for (Node* node = firstChild(); node; node = node->next()) {
+    BoundingBox b;
+    uint c;
+    node->updateBounds(b, c);
+    if (node->type() == Type::TransformNode)
+      b = b.transformed(static_cast<TransformNode*>(node)->matrix());
+    box.unite(b);
+    count += c;
+  }
+
+  if (transform) {
+    transform->m_bounds = box;
+    transform->m_geometryCount = count;
+    transform->m_boundsDirty = false;
+  }
+}
+
+void Node::invalidateBounds() {
+  for (Node* node = this; node; node = node->parent()) {
+    if (node->type() != Type::TransformNode) continue;
+
+    TransformNode* transform = static_cast<TransformNode*>(node);
+    if (transform->m_boundsDirty) break;
+    transform->m_boundsDirty = true;
+  }
+}
+
+void Node::markChanged() {
+  const Node* top = this;
+  for (Node* node = this; node; node = node->parent()) {
+    node->m_changeSerial++;
+    top = node;
+  }
+
+  // Subtrees outside the window's tree, e.g. captured by a ShaderSource,
+  // reach it through passes, so the frame can't be skipped.
+  if (m_renderer && top != m_renderer->root()) m_renderer->m_changed = true;
+}
+
 GeometryNode::GeometryNode(Node* parent)
     : Node(parent, Type::GeometryNode), m_material(), m_geometry() {}
 
+void GeometryNode::setGeometry(Geometry* g) {
+  m_geometry = g;
+  m_sharedGeometry = nullptr;
+  invalidateBounds();
+  markChanged();
+}
+
+void GeometryNode::setGeometry(std::shared_ptr<Geometry> g) {
+  setGeometry(g.get());
+  m_sharedGeometry = std::move(g);
+}
+
+void GeometryNode::setMaterial(Material* m) {
+  m_material = m;
+  markChanged();
+}
+
 TransformNode::TransformNode(Node* parent)
-    : Node(parent, Type::TransformNode) {}
+    : Node(parent, Type::TransformNode),
+      m_geometryCount(),
+      m_boundsDirty(true) {}
+
+void TransformNode::setMatrix(const QMatrix4x4& m) {
+  m_matrix = m;
+  if (parent()) parent()->invalidateBounds();
+  markChanged();
+}
+
+ClipNode::ClipNode(Node* parent)
+    : Node(parent, Type::ClipNode), m_clipGeometry(), m_rectGeometryDirty() {}
+
+ClipNode::~ClipNode() {}
+
+void ClipNode::setClipRect(const QRectF& rect) {
+  m_clipRect = rect;
+  m_rectGeometryDirty = true;
+  markChanged();
+}
+
+void ClipNode::setClipGeometry(Geometry* g) {
+  m_clipGeometry = g;
+  markChanged();
+}
+
+BoundingBox ClipNode::clipBounds() const {
+  if (m_clipGeometry) return m_clipGeometry->boundingBox();
+  if (m_clipRect.isEmpty()) return BoundingBox();
+  return BoundingBox(QVector3D(m_clipRect.left(), m_clipRect.top(), 0),
+                     QVector3D(m_clipRect.right(), m_clipRect.bottom(), 0));
+}
+
+Geometry* ClipNode::stencilGeometry() {
+  if (m_clipGeometry) return m_clipGeometry;
+
+  if (!m_rectGeometry) {
+    m_rectGeometry = std::make_unique<Geometry>(
+        std::vector<Attribute>{{2, GL_FLOAT}}, 4, 2 * sizeof(float));
+    m_rectGeometry->setDrawingMode(GL_TRIANGLE_STRIP);
+    m_rectGeometryDirty = true;
+  }
+
+  if (m_rectGeometryDirty) {
+    float* v = m_rectGeometry->vertexData<float>();
+    const QRectF& r = m_clipRect;
+    const float vertex[] = {float(r.left()),  float(r.top()),
+                            float(r.right()), float(r.top()),
+                            float(r.left()),  float(r.bottom()),
+                            float(r.right()), float(r.bottom())};
+    std::copy(vertex, vertex + 8, v);
+    m_rectGeometry->updateVertexData();
+    m_rectGeometryDirty = false;
+  }
+
+  return m_rectGeometry.get();
+}
 }  // namespace SceneGraph
@@ -1,7 +1,11 @@
 ﻿#ifndef NODE_HPP
 #define NODE_HPP
 #include <QMatrix4x4>
+#include <QRectF>
+#include <memory>
+#include <vector>
 #include "BaseObject.hpp"
+#include "BoundingBox.hpp"
 
 namespace SceneGraph {
 
@@ -11,21 +15,32 @@ class Geometry;
 
 class Node : protected BaseObject {
  public:
-  enum class Type { None, GeometryNode, TransformNode };
+  enum class Type { None, GeometryNode, TransformNode, ClipNode };
 
   enum Flag { UsePreprocess = 1 << 0 };
 
  private:
   friend class Renderer;
+  friend class RenderGraph;
 
   Renderer* m_renderer;
   Type m_type;
   Flag m_flag;
+  uint m_changeSerial;
 
   void setRenderer(Renderer*);
+  void updateBounds(BoundingBox&, uint& geometryCount) const;
 
  protected:
+  // Render graph hooks of nodes flagged UsePreprocess. prepare() lists the
+  // passes whose output this pass reads, preprocess() runs after all of them
+  // and releaseOutput() after the last reader of the output this frame.
+  virtual void prepare(std::vector<Node*>& inputs);
   virtual void preprocess();
+  virtual void releaseOutput();
+  // Transient outputs are only produced for frames which read them, others
+  // are kept up to date in every frame.
+  virtual bool transientOutput() const;
 
  public:
   Node(Node* parent = nullptr, Type type = Type::None);
@@ -42,32 +57,81 @@ class Node : protected BaseObject {
 
   inline Flag flag() const { return m_flag; }
   void setFlag(Flag f);
+
+  // Bounds of the subtree in this node's coordinate space, cached on
+  // TransformNodes. Call invalidateBounds() after changing geometry data.
+  BoundingBox boundingBox() const;
+  uint geometryCount() const;
+  void invalidateBounds();
+
+  // Bumped on this node and its ancestors whenever the subtree changes, so
+  // consumers of a subtree can tell whether it needs to be drawn again.
+  inline uint changeSerial() const { return m_changeSerial; }
+  void markChanged();
 };
 
 class GeometryNode : public Node {
  private:
   Material* m_material;
   Geometry* m_geometry;
+  std::shared_ptr<Geometry> m_sharedGeometry;
 
  public:
   GeometryNode(Node* parent = nullptr);
 
-  inline void setMaterial(Material* m) { m_material = m; }
+  void setMaterial(Material* m);
   inline Material* material() const { return m_material; }
 
-  inline void setGeometry(Geometry* g) { m_geometry = g; }
+  void setGeometry(Geometry* g);
+  // Keeps the geometry alive for as long as the node uses it, e.g. one
+  // handed out by GeometryCache.
+  void setGeometry(std::shared_ptr<Geometry> g);
   inline Geometry* geometry() const { return m_geometry; }
 };
 
 class TransformNode : public Node {
  private:
+  friend class Node;
+
   QMatrix4x4 m_matrix;
+  mutable BoundingBox m_bounds;
+  mutable uint m_geometryCount;
+  mutable bool m_boundsDirty;
 
  public:
   TransformNode(Node* parent = nullptr);
 
   inline const QMatrix4x4& matrix() const { return m_matrix; }
-  inline void setMatrix(const QMatrix4x4& m) { m_matrix = m; }
+  void setMatrix(const QMatrix4x4& m);
+};
+// Restricts drawing of its subtree to a rectangle, or to the triangles of a
+// clip geometry. Rectangles which stay axis aligned on screen are scissored,
+// everything else goes through the stencil buffer.
+class ClipNode : public Node {
+ private:
+  QRectF m_clipRect;
+  Geometry* m_clipGeometry;
+  std::unique_ptr<Geometry> m_rectGeometry;
+  bool m_rectGeometryDirty;
+
+ public:
+  ClipNode(Node* parent = nullptr);
+  ~ClipNode();
+
+  inline const QRectF& clipRect() const { return m_clipRect; }
+  void setClipRect(const QRectF&);
+
+  // Used instead of the rectangle when set, its first attribute holds the
+  // positions.
+  inline Geometry* clipGeometry() const { return m_clipGeometry; }
+  void setClipGeometry(Geometry*);
+
+  inline bool isRectangular() const { return !m_clipGeometry; }
+
+  BoundingBox clipBounds() const;
+
+  // Geometry to draw into the stencil buffer.
+  Geometry* stencilGeometry();
 };
 }  // namespace SceneGraph
 
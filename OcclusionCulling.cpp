@@ -0,0 +1,181 @@
+#include "OcclusionCulling.hpp"
+#include <QOpenGLContext>
+#include <cassert>
+#include <cstring>
+#include "Geometry.hpp"
+#include "Renderer.hpp"
+
+namespace SceneGraph {
+
+namespace {
+
+const float BOX_VERTEX[] = {0, 0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 0,
+                            0, 0, 1, 1, 0, 1, 0, 1, 1, 1, 1, 1};
+const GLushort BOX_INDEX[] = {0, 1, 2, 2, 1, 3, 4, 6, 5, 5, 6, 7,
+                              0, 2, 4, 4, 2, 6, 1, 5, 3, 3, 5, 7,
+                              0, 4, 1, 1, 4, 5, 2, 3, 6, 6, 3, 7};
+
+// Results older than this are not trusted to keep a subtree hidden.
+const uint MAX_RESULT_AGE = 2;
+}  // namespace
+
+OcclusionCulling::OcclusionCulling()
+    : m_target(),
+      m_enabled(),
+      m_minimumGeometryCount(16),
+      m_maximumCoverage(0.5),
+      m_frame() {
+  initializeOpenGLFunctions();
+
+  QOpenGLContext* context = QOpenGLContext::currentContext();
+  QSurfaceFormat format = context->format();
+  int version = format.majorVersion() * 10 + format.minorVersion();
+  if (context->isOpenGLES()) {
+    if (version >= 30) m_target = GL_ANY_SAMPLES_PASSED;
+  } else if (version >= 33 ||
+             context->hasExtension("GL_ARB_occlusion_query2")) {
+    m_target = GL_ANY_SAMPLES_PASSED;
+  } else {
+#ifdef GL_SAMPLES_PASSED
+    m_target = GL_SAMPLES_PASSED;
+#endif
+  }
+
+  m_box = std::make_unique<Geometry>(std::vector<Attribute>{{3, GL_FLOAT}}, 8,
+                                     3 * sizeof(float), 36, GL_UNSIGNED_SHORT);
+  m_box->setDrawingMode(GL_TRIANGLES);
+  memcpy(m_box->vertexData(), BOX_VERTEX, sizeof(BOX_VERTEX));
+  memcpy(m_box->indexData(), BOX_INDEX, sizeof(BOX_INDEX));
+  m_box->updateVertexData();
+}
+
+OcclusionCulling::~OcclusionCulling() {
+  for (auto& p : m_query) m_free.push_back(p.second.id);
+  if (!m_free.empty()) glDeleteQueries(m_free.size(), m_free.data());
+}
+
+bool OcclusionCulling::candidate(const QMatrix4x4& matrix,
+                                 const BoundingBox& box,
+                                 uint geometryCount) const {
+  if (!m_enabled || !supported() || geometryCount < m_minimumGeometryCount)
+    return false;
+  if (box.isEmpty() || box.isInfinite() || box.min().x() == box.max().x() ||
+      box.min().y() == box.max().y())
+    return false;
+
+  // A box crossing the near plane would be clipped and could report the
+  // subtree hidden while the camera is inside it.
+  QRectF rect;
+  for (int i = 0; i < 8; i++) {
+    QVector4D p(i & 1 ? box.max().x() : box.min().x(),
+                i & 2 ? box.max().y() : box.min().y(),
+                i & 4 ? box.max().z() : box.min().z(), 1);
+    p = matrix * p;
+    if (p.w() <= 0 || p.z() < -p.w()) return false;
+
+    QPointF ndc(p.x() / p.w(), p.y() / p.w());
+    rect = i == 0 ? QRectF(ndc, ndc) : rect.united(QRectF(ndc, ndc));
+  }
+
+  QRectF visible = rect.intersected(QRectF(-1, -1, 2, 2));
+  return visible.width() * visible.height() / 4 <= m_maximumCoverage;
+}
+
+bool OcclusionCulling::occluded(const Node* node) const {
+  auto it = m_query.find(node);
+  if (it == m_query.end()) return false;
+
+  const Query& query = it->second;
+  return !query.visible && m_frame - query.frame <= MAX_RESULT_AGE;
+}
+
+void OcclusionCulling::poll(uint frame) {
+  m_frame = frame;
+
+  for (auto& p : m_query) {
+    Query& query = p.second;
+    if (!query.pending) continue;
+
+    GLuint available = 0;
+    glGetQueryObjectuiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) continue;
+
+    GLuint result = 0;
+    glGetQueryObjectuiv(query.id, GL_QUERY_RESULT, &result);
+    query.visible = result != 0;
+    query.pending = false;
+  }
+}
+
+void OcclusionCulling::issue(const std::vector<Candidate>& candidates) {
+  if (candidates.empty()) return;
+
+  GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+  GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+  GLboolean depthMask;
+  glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+  GLint depthFunc;
+  glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  glDepthMask(GL_FALSE);
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_LEQUAL);
+  glDisable(GL_CULL_FACE);
+
+  Shader* shader = OcclusionCulling::shader();
+  assert(shader->initialized());
+  shader->bind();
+  m_box->bind(shader->attributeLocation());
+
+  for (const Candidate& c : candidates) {
+    Query& query = m_query[c.node];
+    if (query.pending) continue;
+    if (!query.id) {
+      if (m_free.empty()) {
+        query.id = 0;
+        glGenQueries(1, &query.id);
+      } else {
+        query.id = m_free.back();
+        m_free.pop_back();
+      }
+      query.visible = true;
+    }
+
+    QMatrix4x4 matrix = c.matrix;
+    matrix.translate(c.box.min());
+    matrix.scale(c.box.max() - c.box.min());
+
+    glBeginQuery(m_target, query.id);
+    shader->updateState(nullptr, RenderState(matrix));
+    glDrawElements(m_box->drawingMode(), m_box->indexCount(),
+                   m_box->indexType(), nullptr);
+    glEndQuery(m_target);
+
+    query.pending = true;
+    query.frame = m_frame;
+  }
+
+  m_box->release();
+
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glDepthMask(depthMask);
+  glDepthFunc(GLenum(depthFunc));
+  if (!depthTest) glDisable(GL_DEPTH_TEST);
+  if (cullFace) glEnable(GL_CULL_FACE);
+}
+
+Shader* OcclusionCulling::shader() const {
+  return Shader::get<PositionShader>();
+}
+
+void OcclusionCulling::nodeDestroyed(const Node* node) {
+  auto it = m_query.find(node);
+  if (it == m_query.end()) return;
+
+  // The query may still be in flight, its id is only reused once a new
+  // query is begun on it.
+  m_free.push_back(it->second.id);
+  m_query.erase(it);
+}
+}  // namespace SceneGraph
@@ -0,0 +1,73 @@
+#ifndef OCCLUSIONCULLING_HPP
+#define OCCLUSIONCULLING_HPP
+#include <QOpenGLExtraFunctions>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "BoundingBox.hpp"
+#include "Shader.hpp"
+
+namespace SceneGraph {
+
+class Node;
+class Geometry;
+
+// Hardware occlusion queries against subtree bounding boxes. Results are read
+// back a frame late, so a subtree hidden last frame is skipped this frame
+// while its box is tested again.
+class OcclusionCulling : protected QOpenGLExtraFunctions {
+ public:
+  struct Candidate {
+    const Node* node;
+    QMatrix4x4 matrix;
+    BoundingBox box;
+  };
+
+ private:
+  struct Query {
+    GLuint id;
+    bool pending;
+    bool visible;
+    uint frame;
+  };
+
+  std::unordered_map<const Node*, Query> m_query;
+  std::vector<GLuint> m_free;
+  std::unique_ptr<Geometry> m_box;
+  GLenum m_target;
+  bool m_enabled;
+  uint m_minimumGeometryCount;
+  float m_maximumCoverage;
+  uint m_frame;
+
+ public:
+  OcclusionCulling();
+  ~OcclusionCulling();
+
+  inline bool supported() const { return m_target != 0; }
+
+  inline bool enabled() const { return m_enabled; }
+  inline void setEnabled(bool e) { m_enabled = e; }
+
+  // Subtrees with fewer GeometryNodes are always drawn.
+  inline uint minimumGeometryCount() const { return m_minimumGeometryCount; }
+  inline void setMinimumGeometryCount(uint c) { m_minimumGeometryCount = c; }
+
+  // Subtrees covering a larger fraction of the viewport are always drawn.
+  inline float maximumCoverage() const { return m_maximumCoverage; }
+  inline void setMaximumCoverage(float c) { m_maximumCoverage = c; }
+
+  bool candidate(const QMatrix4x4&, const BoundingBox&,
+                 uint geometryCount) const;
+  bool occluded(const Node*) const;
+
+  // Draws the boxes, has to be prepared by the renderer before issue().
+  Shader* shader() const;
+
+  void poll(uint frame);
+  void issue(const std::vector<Candidate>&);
+  void nodeDestroyed(const Node*);
+};
+}  // namespace SceneGraph
+
+#endif  // OCCLUSIONCULLING_HPP
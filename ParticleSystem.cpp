@@ -0,0 +1,298 @@
+#include "ParticleSystem.hpp"
+#include <cmath>
+#include <random>
+
+namespace SceneGraph {
+
+namespace {
+
+const uint VERTEX_SIZE = 6;
+
+// Interval of the timer advancing the clock, in milliseconds.
+const int FRAME_INTERVAL = 16;
+
+// Particles respawn with their velocity turned by up to this fraction of the
+// spread, so consecutive generations do not repeat the same paths.
+const float RESPAWN_JITTER = 0.5f;
+}  // namespace
+
+ParticleSystem::ParticleSystem(Item* parent)
+    : Item(parent),
+      m_emitRect(0, 0, 0, 0),
+      m_emitRate(100),
+      m_lifetime(1),
+      m_direction(-M_PI / 2),
+      m_spread(M_PI / 8),
+      m_minimumSpeed(1),
+      m_maximumSpeed(1),
+      m_beginColor(Qt::white),
+      m_endColor(Qt::transparent),
+      m_beginSize(4),
+      m_endSize(4),
+      m_running(true),
+      m_emitterChanged(true),
+      m_timer(),
+      m_paused(),
+      m_pauseStart() {
+  m_clock.start();
+}
+
+void ParticleSystem::emitterChanged() {
+  m_emitterChanged = true;
+  update();
+}
+
+void ParticleSystem::setEmitRect(QRectF rect) {
+  m_emitRect = rect;
+  emitterChanged();
+}
+
+void ParticleSystem::setEmitRate(float rate) {
+  m_emitRate = rate;
+  emitterChanged();
+}
+
+void ParticleSystem::setLifetime(float lifetime) {
+  m_lifetime = lifetime;
+  emitterChanged();
+}
+
+void ParticleSystem::setDirection(float direction) {
+  m_direction = direction;
+  emitterChanged();
+}
+
+void ParticleSystem::setSpread(float spread) {
+  m_spread = spread;
+  emitterChanged();
+}
+
+void ParticleSystem::setSpeed(float minimum, float maximum) {
+  m_minimumSpeed = minimum;
+  m_maximumSpeed = maximum;
+  emitterChanged();
+}
+
+void ParticleSystem::setAcceleration(QVector2D acceleration) {
+  m_acceleration = acceleration;
+  emitterChanged();
+}
+
+void ParticleSystem::setColor(QColor begin, QColor end) {
+  m_beginColor = begin;
+  m_endColor = end;
+  update();
+}
+
+void ParticleSystem::setSize(float begin, float end) {
+  m_beginSize = begin;
+  m_endSize = end;
+  update();
+}
+
+void ParticleSystem::setRunning(bool running) {
+  if (m_running == running) return;
+  m_running = running;
+  if (running) {
+    m_paused += m_clock.elapsed() - m_pauseStart;
+  } else {
+    m_pauseStart = m_clock.elapsed();
+    if (m_timer) {
+      killTimer(m_timer);
+      m_timer = 0;
+    }
+  }
+  update();
+}
+
+qint64 ParticleSystem::elapsed() const {
+  return (m_running ? m_clock.elapsed() : m_pauseStart) - m_paused;
+}
+
+void ParticleSystem::invalidate() {
+  Item::invalidate();
+  m_emitterChanged = true;
+}
+
+void ParticleSystem::timerEvent(QTimerEvent*) { update(); }
+
+std::unique_ptr<Node> ParticleSystem::synchronize(std::unique_ptr<Node> node) {
+  if (m_running && !m_timer) m_timer = startTimer(FRAME_INTERVAL);
+
+  if (!node) {
+    node = std::make_unique<ParticleNode>();
+    m_emitterChanged = true;
+  }
+  static_cast<ParticleNode*>(node.get())->update(this);
+  return node;
+}
+
+ParticleSystem::ParticleNode::ParticleNode(Node* parent)
+    : GeometryNode(parent),
+      m_particles({{2, GL_FLOAT}, {2, GL_FLOAT}, {2, GL_FLOAT}}, 0,
+                  VERTEX_SIZE * sizeof(float)) {
+  m_particles.setDrawingMode(GL_POINTS);
+  setGeometry(&m_particles);
+  setMaterial(&m_particleMaterial);
+}
+
+void ParticleSystem::ParticleNode::update(ParticleSystem* system) {
+  ParticleMaterial& m = m_particleMaterial;
+  float lifetime = std::max(system->m_lifetime, 0.001f);
+
+  if (system->m_emitterChanged) {
+    system->m_emitterChanged = false;
+
+    uint count = uint(std::max(system->m_emitRate, 0.0f) * lifetime);
+    m_particles.allocate(count, 0);
+
+    std::mt19937 random;
+    std::uniform_real_distribution<float> unit;
+    const QRectF& rect = system->m_emitRect;
+    float* v = m_particles.vertexData<float>();
+    for (uint i = 0; i < count; i++, v += VERTEX_SIZE) {
+      float angle =
+          system->m_direction + (unit(random) - 0.5f) * system->m_spread;
+      float speed = system->m_minimumSpeed +
+                    unit(random) * (system->m_maximumSpeed -
+                                    system->m_minimumSpeed);
+      v[0] = float(rect.x() + unit(random) * rect.width());
+      v[1] = float(rect.y() + unit(random) * rect.height());
+      v[2] = speed * std::cos(angle);
+      v[3] = speed * std::sin(angle);
+      // Emission times are spread evenly over the lifetime.
+      v[4] = i / system->m_emitRate;
+      v[5] = unit(random);
+    }
+    m_particles.updateVertexData();
+
+    // Farthest a particle gets from the emitter, vertices only hold the
+    // origins.
+    float reach = std::max(std::abs(system->m_minimumSpeed),
+                           std::abs(system->m_maximumSpeed)) *
+                      lifetime +
+                  system->m_acceleration.length() * lifetime * lifetime / 2;
+    m_particles.setBoundingBox(
+        BoundingBox(QVector3D(rect.left() - reach, rect.top() - reach, 0),
+                    QVector3D(rect.right() + reach, rect.bottom() + reach, 0)));
+    invalidateBounds();
+  }
+
+  // Whole lifetimes are dropped once every particle was emitted, so the ages
+  // stay the same while the float keeps its precision.
+  qreal time = system->elapsed() / 1000.0;
+  if (time > lifetime)
+    time = lifetime + std::fmod(time - lifetime, 1024 * lifetime);
+  m.m_time = float(time);
+  m.m_lifetime = lifetime;
+  m.m_acceleration = system->m_acceleration;
+  m.m_jitter = RESPAWN_JITTER * system->m_spread;
+  m.m_beginColor = system->m_beginColor;
+  m.m_endColor = system->m_endColor;
+  m.m_beginSize = system->m_beginSize;
+  m.m_endSize = system->m_endSize;
+}
+
+ParticleSystem::ParticleMaterial::ParticleMaterial()
+    : m_time(),
+      m_lifetime(1),
+      m_jitter(),
+      m_beginSize(1),
+      m_endSize(1) {}
+
+Shader* ParticleSystem::ParticleMaterial::shader() const {
+  return Shader::get<ParticleShader>();
+}
+
+void ParticleSystem::ParticleMaterial::ParticleShader::initialize() {
+  Shader::initialize();
+
+  m_matrix = program()->uniformLocation("matrix");
+  m_time = program()->uniformLocation("time");
+  m_lifetime = program()->uniformLocation("lifetime");
+  m_acceleration = program()->uniformLocation("acceleration");
+  m_jitter = program()->uniformLocation("jitter");
+  m_beginColor = program()->uniformLocation("beginColor");
+  m_endColor = program()->uniformLocation("endColor");
+  m_beginSize = program()->uniformLocation("beginSize");
+  m_endSize = program()->uniformLocation("endSize");
+}
+
+// Point sizes from the shader are context state, and the shader is shared by
+// the contexts of a share group.
+void ParticleSystem::ParticleMaterial::ParticleShader::activate() {
+#ifdef GL_VERTEX_PROGRAM_POINT_SIZE
+  functions()->glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+#endif
+}
+
+void ParticleSystem::ParticleMaterial::ParticleShader::deactivate() {
+#ifdef GL_VERTEX_PROGRAM_POINT_SIZE
+  functions()->glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
+#endif
+}
+
+const char* ParticleSystem::ParticleMaterial::ParticleShader::vertexShader()
+    const {
+  return GLSL(
+      attribute vec2 origin; attribute vec2 velocity; attribute vec2 emission;
+      uniform mat4 matrix; uniform float time; uniform float lifetime;
+      uniform vec2 acceleration; uniform float jitter; uniform vec4 beginColor;
+      uniform vec4 endColor; uniform float beginSize; uniform float endSize;
+      varying vec4 fcolor;
+
+      void main() {
+        float elapsed = time - emission.x;
+        float generation = floor(elapsed / lifetime);
+        float age = elapsed - generation * lifetime;
+        float t = age / lifetime;
+
+        float turn = (fract(sin(emission.y * 12.9898 + generation * 78.233) *
+                            43758.5453) -
+                      0.5) *
+                     jitter;
+        vec2 v = vec2(cos(turn) * velocity.x - sin(turn) * velocity.y,
+                      sin(turn) * velocity.x + cos(turn) * velocity.y);
+        vec2 position = origin + v * age + 0.5 * acceleration * age * age;
+
+        // Particles not emitted yet stay invisible.
+        float alive = elapsed < 0.0 ? 0.0 : 1.0;
+        fcolor = mix(beginColor, endColor, t);
+        fcolor.a *= alive;
+        gl_PointSize = mix(beginSize, endSize, t) * alive;
+        gl_Position = matrix * vec4(position, 0.0, 1.0);
+      });
+}
+
+const char* ParticleSystem::ParticleMaterial::ParticleShader::fragmentShader()
+    const {
+  return GLSL(varying vec4 fcolor;
+
+              void main() {
+                vec2 p = gl_PointCoord * 2.0 - 1.0;
+                float d = dot(p, p);
+                if (d > 1.0) discard;
+                gl_FragColor = vec4(fcolor.rgb, fcolor.a * (1.0 - d));
+              });
+}
+
+std::vector<std::string>
+ParticleSystem::ParticleMaterial::ParticleShader::attribute() const {
+  return {"origin", "velocity", "emission"};
+}
+
+void ParticleSystem::ParticleMaterial::ParticleShader::updateState(
+    const Material* m, const RenderState& state) {
+  const ParticleMaterial* material = static_cast<const ParticleMaterial*>(m);
+
+  program()->setUniformValue(m_matrix, state.matrix());
+  program()->setUniformValue(m_time, material->m_time);
+  program()->setUniformValue(m_lifetime, material->m_lifetime);
+  program()->setUniformValue(m_acceleration, material->m_acceleration);
+  program()->setUniformValue(m_jitter, material->m_jitter);
+  program()->setUniformValue(m_beginColor, material->m_beginColor);
+  program()->setUniformValue(m_endColor, material->m_endColor);
+  program()->setUniformValue(m_beginSize, material->m_beginSize);
+  program()->setUniformValue(m_endSize, material->m_endSize);
+}
+}  // namespace SceneGraph
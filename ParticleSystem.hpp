@@ -0,0 +1,154 @@
+#ifndef PARTICLESYSTEM_HPP
+#define PARTICLESYSTEM_HPP
+#include <QColor>
+#include <QElapsedTimer>
+#include <QRectF>
+#include <QVector2D>
+#include "Geometry.hpp"
+#include "Item.hpp"
+#include "Material.hpp"
+#include "Node.hpp"
+
+namespace SceneGraph {
+
+// Particles emitted at a steady rate from a rectangle, drawn as point
+// sprites. Each particle is uploaded once with its origin, velocity and
+// emission time; the vertex shader derives its age from the time uniform and
+// respawns it at the emitter when its lifetime runs out, so the CPU only
+// advances the clock each frame.
+class ParticleSystem : public Item {
+ public:
+  class ParticleMaterial : public Material {
+   private:
+    class ParticleShader : public Shader {
+     private:
+      int m_matrix;
+      int m_time;
+      int m_lifetime;
+      int m_acceleration;
+      int m_jitter;
+      int m_beginColor;
+      int m_endColor;
+      int m_beginSize;
+      int m_endSize;
+
+     protected:
+      void initialize() override;
+
+      void activate() override;
+      void deactivate() override;
+
+      const char* vertexShader() const override;
+      const char* fragmentShader() const override;
+
+      std::vector<std::string> attribute() const override;
+
+      void updateState(const Material*, const RenderState&) override;
+    };
+
+    friend class ParticleSystem;
+
+    float m_time;
+    float m_lifetime;
+    QVector2D m_acceleration;
+    float m_jitter;
+    QColor m_beginColor;
+    QColor m_endColor;
+    float m_beginSize;
+    float m_endSize;
+
+   public:
+    ParticleMaterial();
+
+    Shader* shader() const override;
+  };
+
+  class ParticleNode : public GeometryNode {
+   private:
+    friend class ParticleSystem;
+
+    Geometry m_particles;
+    ParticleMaterial m_particleMaterial;
+
+    void update(ParticleSystem*);
+
+   public:
+    ParticleNode(Node* parent = nullptr);
+  };
+
+ private:
+  QRectF m_emitRect;
+  float m_emitRate;
+  float m_lifetime;
+  float m_direction;
+  float m_spread;
+  float m_minimumSpeed;
+  float m_maximumSpeed;
+  QVector2D m_acceleration;
+  QColor m_beginColor;
+  QColor m_endColor;
+  float m_beginSize;
+  float m_endSize;
+  bool m_running;
+  bool m_emitterChanged;
+  int m_timer;
+  QElapsedTimer m_clock;
+  // Milliseconds of the clock spent paused, and when the current pause began.
+  qint64 m_paused;
+  qint64 m_pauseStart;
+
+  qint64 elapsed() const;
+
+  void emitterChanged();
+
+ protected:
+  std::unique_ptr<Node> synchronize(std::unique_ptr<Node> old) override;
+  void timerEvent(QTimerEvent*) override;
+
+ public:
+  ParticleSystem(Item* parent = nullptr);
+
+  inline QRectF emitRect() const { return m_emitRect; }
+  void setEmitRect(QRectF);
+
+  // Particles per second, the system holds emitRate * lifetime of them.
+  inline float emitRate() const { return m_emitRate; }
+  void setEmitRate(float);
+
+  // In seconds.
+  inline float lifetime() const { return m_lifetime; }
+  void setLifetime(float);
+
+  // Angle of the initial velocity in radians, spread evenly over the spread
+  // around it.
+  inline float direction() const { return m_direction; }
+  void setDirection(float);
+
+  inline float spread() const { return m_spread; }
+  void setSpread(float);
+
+  inline float minimumSpeed() const { return m_minimumSpeed; }
+  inline float maximumSpeed() const { return m_maximumSpeed; }
+  void setSpeed(float minimum, float maximum);
+
+  inline QVector2D acceleration() const { return m_acceleration; }
+  void setAcceleration(QVector2D);
+
+  // Interpolated over the lifetime of a particle; sizes are in pixels.
+  inline QColor beginColor() const { return m_beginColor; }
+  inline QColor endColor() const { return m_endColor; }
+  void setColor(QColor begin, QColor end);
+
+  inline float beginSize() const { return m_beginSize; }
+  inline float endSize() const { return m_endSize; }
+  void setSize(float begin, float end);
+
+  // Paused particles stay where they are and carry on from there.
+  inline bool running() const { return m_running; }
+  void setRunning(bool);
+
+  void invalidate() override;
+};
+}  // namespace SceneGraph
+
+#endif  // PARTICLESYSTEM_HPP
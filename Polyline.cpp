@@ -0,0 +1,313 @@
+#include "Polyline.hpp"
+#include <algorithm>
+
+namespace SceneGraph {
+
+namespace {
+
+const uint VERTEX_SIZE = 7;
+
+// Below this many samples per column the samples are drawn as they are.
+const uint MINIMUM_DECIMATED_RUN = 4;
+
+// Longest miter over the line's extent, as limited in the shader.
+const float MITER_LIMIT = 4;
+}  // namespace
+
+PolylineGeometry::PolylineGeometry()
+    : Geometry({{2, GL_FLOAT}, {2, GL_FLOAT}, {2, GL_FLOAT}, {1, GL_FLOAT}},
+               0, VERTEX_SIZE * sizeof(float)),
+      m_begin(),
+      m_end(),
+      m_columns(),
+      m_lower(1, 1),
+      m_upper(),
+      m_padding(0, 0) {
+  setDrawingMode(GL_TRIANGLES);
+}
+
+void PolylineGeometry::setSamples(std::vector<QPointF> sample) {
+  m_sample = std::move(sample);
+  buildPyramid();
+  m_columns = 0;
+}
+
+void PolylineGeometry::buildPyramid() {
+  m_minimum.clear();
+  m_maximum.clear();
+
+  uint count = m_sample.size();
+  while (count > 1) {
+    bool first = m_minimum.empty();
+    std::vector<uint> minimum((count + 1) / 2), maximum((count + 1) / 2);
+    for (uint i = 0; i < minimum.size(); i++) {
+      uint a = 2 * i, b = std::min(2 * i + 1, count - 1);
+      uint amin = first ? a : m_minimum.back()[a];
+      uint bmin = first ? b : m_minimum.back()[b];
+      uint amax = first ? a : m_maximum.back()[a];
+      uint bmax = first ? b : m_maximum.back()[b];
+      minimum[i] = m_sample[bmin].y() < m_sample[amin].y() ? bmin : amin;
+      maximum[i] = m_sample[bmax].y() > m_sample[amax].y() ? bmax : amax;
+    }
+    m_minimum.push_back(std::move(minimum));
+    m_maximum.push_back(std::move(maximum));
+    count = m_minimum.back().size();
+  }
+}
+
+void PolylineGeometry::extremes(uint begin, uint end, uint& minimum,
+                                uint& maximum) const {
+  minimum = maximum = begin;
+  auto take = [&](uint lo, uint hi) {
+    if (m_sample[lo].y() < m_sample[minimum].y()) minimum = lo;
+    if (m_sample[hi].y() > m_sample[maximum].y()) maximum = hi;
+  };
+
+  // Climbs the pyramid, taking the runs which stick out of the range on the
+  // way up.
+  for (uint level = 0; begin < end; level++) {
+    if (begin & 1) {
+      if (level == 0)
+        take(begin, begin);
+      else
+        take(m_minimum[level - 1][begin], m_maximum[level - 1][begin]);
+      begin++;
+    }
+    if (end & 1) {
+      end--;
+      if (level == 0)
+        take(end, end);
+      else
+        take(m_minimum[level - 1][end], m_maximum[level - 1][end]);
+    }
+    begin >>= 1;
+    end >>= 1;
+  }
+}
+
+void PolylineGeometry::setView(qreal begin, qreal end, uint columns) {
+  if (begin == m_begin && end == m_end && columns == m_columns) return;
+  m_begin = begin;
+  m_end = end;
+  m_columns = columns;
+
+  std::vector<QPointF> point;
+  if (m_sample.size() >= 2 && columns > 0 && end > begin) {
+    auto index = [this](qreal x) {
+      return uint(std::lower_bound(m_sample.begin(), m_sample.end(), x,
+                                   [](const QPointF& p, qreal x) {
+                                     return p.x() < x;
+                                   }) -
+                  m_sample.begin());
+    };
+
+    // One sample either side of the view keeps the line running off screen.
+    uint first = index(begin), last = index(end);
+    if (first > 0) first--;
+    if (last < m_sample.size()) last++;
+
+    qreal step = (end - begin) / columns;
+    for (uint i = first; i < last;) {
+      uint column = m_sample[i].x() < begin
+                        ? 0
+                        : uint((m_sample[i].x() - begin) / step) + 1;
+      uint next = std::max(i + 1, std::min(last, index(begin + column * step)));
+      if (next - i < MINIMUM_DECIMATED_RUN) {
+        for (; i < next; i++) point.push_back(m_sample[i]);
+        continue;
+      }
+
+      uint minimum, maximum;
+      extremes(i, next, minimum, maximum);
+      point.push_back(m_sample[i]);
+      if (minimum != i && minimum != next - 1 && minimum < maximum)
+        point.push_back(m_sample[minimum]);
+      if (maximum != i && maximum != next - 1)
+        point.push_back(m_sample[maximum]);
+      if (minimum != i && minimum != next - 1 && minimum > maximum)
+        point.push_back(m_sample[minimum]);
+      point.push_back(m_sample[next - 1]);
+      i = next;
+    }
+  }
+
+  buildSegments(point);
+}
+
+void PolylineGeometry::setPadding(QSizeF padding) {
+  if (padding == m_padding) return;
+  m_padding = padding;
+  updateBounds();
+}
+
+void PolylineGeometry::buildSegments(const std::vector<QPointF>& point) {
+  uint count = point.size() < 2 ? 0 : point.size();
+  uint segments = count ? count - 1 : 0;
+  allocate(2 * count, 6 * segments);
+
+  // A strip of two vertices per point, each knowing its neighbours. The
+  // shader pushes them out along the bisector of the joint, so segments meet
+  // without gaps or overlap, and past the ends by half the width.
+  float* v = vertexData<float>();
+  m_lower = QPointF(1, 1);
+  m_upper = QPointF(0, 0);
+  for (uint i = 0; i < count; i++) {
+    const QPointF& p = point[i];
+    if (i == 0) m_lower = m_upper = p;
+    m_lower.rx() = std::min(m_lower.x(), p.x());
+    m_lower.ry() = std::min(m_lower.y(), p.y());
+    m_upper.rx() = std::max(m_upper.x(), p.x());
+    m_upper.ry() = std::max(m_upper.y(), p.y());
+    const QPointF& previous = point[i > 0 ? i - 1 : i];
+    const QPointF& next = point[i + 1 < count ? i + 1 : i];
+    for (int side = 0; side < 2; side++, v += VERTEX_SIZE) {
+      v[0] = float(p.x());
+      v[1] = float(p.y());
+      v[2] = float(previous.x());
+      v[3] = float(previous.y());
+      v[4] = float(next.x());
+      v[5] = float(next.y());
+      v[6] = side ? 1 : -1;
+    }
+  }
+
+  GLuint* index = indexData<GLuint>();
+  for (uint i = 0; i < segments; i++) {
+    const GLuint quad[] = {0, 1, 2, 2, 1, 3};
+    for (GLuint q : quad) *index++ = 2 * i + q;
+  }
+
+  updateVertexData();
+  updateBounds();
+}
+
+void PolylineGeometry::updateBounds() {
+  // The centerline's box misses the width and the miters the shader adds.
+  if (m_lower.x() > m_upper.x()) {
+    setBoundingBox(BoundingBox());
+    return;
+  }
+  qreal dx = m_padding.width(), dy = m_padding.height();
+  setBoundingBox(BoundingBox(QVector3D(m_lower.x() - dx, m_lower.y() - dy, 0),
+                             QVector3D(m_upper.x() + dx, m_upper.y() + dy, 0)));
+}
+
+PolylineMaterial::PolylineMaterial() : m_color(Qt::black), m_width(1) {}
+
+Shader* PolylineMaterial::shader() const {
+  return Shader::get<PolylineShader>();
+}
+
+void PolylineMaterial::PolylineShader::initialize() {
+  Shader::initialize();
+
+  m_matrix = program()->uniformLocation("matrix");
+  m_viewport = program()->uniformLocation("viewport");
+  m_halfWidth = program()->uniformLocation("halfWidth");
+  m_color = program()->uniformLocation("color");
+}
+
+const char* PolylineMaterial::PolylineShader::vertexShader() const {
+  return GLSL(
+      attribute vec2 position; attribute vec2 previous; attribute vec2 next;
+      attribute float side; uniform mat4 matrix; uniform vec2 viewport;
+      uniform float halfWidth; varying float fdistance;
+
+      vec2 screen(vec2 p) {
+        vec4 c = matrix * vec4(p, 0.0, 1.0);
+        return c.xy / c.w * viewport;
+      }
+
+      void main() {
+        vec4 a = matrix * vec4(position, 0.0, 1.0);
+        vec2 p = a.xy / a.w * viewport;
+
+        vec2 incoming = p - screen(previous);
+        vec2 outgoing = screen(next) - p;
+        float inLength = length(incoming);
+        float outLength = length(outgoing);
+        incoming = inLength > 0.0 ? incoming / inLength : vec2(0.0);
+        outgoing = outLength > 0.0 ? outgoing / outLength : vec2(0.0);
+
+        // Ends continue straight, past the point by half the width.
+        vec2 cap = vec2(0.0);
+        if (inLength == 0.0) {
+          incoming = outgoing;
+          cap = -outgoing * halfWidth;
+        }
+        if (outLength == 0.0) {
+          outgoing = incoming;
+          cap = incoming * halfWidth;
+        }
+
+        // Miter along the bisector, limited to four times the width where
+        // the line doubles back.
+        vec2 tangent = incoming + outgoing;
+        float tangentLength = length(tangent);
+        tangent = tangentLength > 0.001 ? tangent / tangentLength : incoming;
+        vec2 normal = vec2(-tangent.y, tangent.x);
+        float miter =
+            1.0 / max(dot(normal, vec2(-incoming.y, incoming.x)), 0.25);
+
+        float extent = halfWidth + 1.0;
+        vec2 q = p + normal * side * extent * miter + cap;
+        fdistance = side * extent;
+        gl_Position = vec4(q / viewport * a.w, a.z, a.w);
+      });
+}
+
+const char* PolylineMaterial::PolylineShader::fragmentShader() const {
+  return GLSL(uniform vec4 color; uniform float halfWidth;
+              varying float fdistance;
+
+              void main() {
+                float coverage =
+                    clamp(halfWidth + 0.5 - abs(fdistance), 0.0, 1.0);
+                gl_FragColor = vec4(color.rgb, color.a * coverage);
+              });
+}
+
+std::vector<std::string> PolylineMaterial::PolylineShader::attribute() const {
+  return {"position", "previous", "next", "side"};
+}
+
+void PolylineMaterial::PolylineShader::updateState(const Material* m,
+                                                   const RenderState& state) {
+  const PolylineMaterial* material = static_cast<const PolylineMaterial*>(m);
+
+  GLint view[4];
+  functions()->glGetIntegerv(GL_VIEWPORT, view);
+
+  program()->setUniformValue(m_matrix, state.matrix());
+  program()->setUniformValue(m_viewport, QVector2D(view[2], view[3]) / 2);
+  program()->setUniformValue(m_halfWidth, material->width() / 2);
+  program()->setUniformValue(m_color, material->color());
+}
+
+PolylineNode::PolylineNode(Node* parent) : GeometryNode(parent) {
+  setGeometry(&m_polyline);
+  setMaterial(&m_polylineMaterial);
+}
+
+void PolylineNode::setSamples(std::vector<QPointF> sample) {
+  m_polyline.setSamples(std::move(sample));
+  invalidateBounds();
+  markChanged();
+}
+
+void PolylineNode::setView(qreal begin, qreal end, uint columns) {
+  m_polyline.setView(begin, end, columns);
+  invalidateBounds();
+  markChanged();
+}
+
+void PolylineNode::setWidth(float width, QSizeF pixel) {
+  m_polylineMaterial.setWidth(width);
+
+  // Past a joint by the miter of the extent, or past an end by the cap.
+  float reach = (width / 2 + 1) * MITER_LIMIT + width / 2;
+  m_polyline.setPadding(pixel * reach);
+  invalidateBounds();
+  markChanged();
+}
+}  // namespace SceneGraph
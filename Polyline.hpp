@@ -0,0 +1,114 @@
+#ifndef POLYLINE_HPP
+#define POLYLINE_HPP
+#include <QColor>
+#include <QPointF>
+#include <QSizeF>
+#include <memory>
+#include <vector>
+#include "Geometry.hpp"
+#include "Material.hpp"
+#include "Node.hpp"
+
+namespace SceneGraph {
+
+// Samples of a series ordered by x, reduced to the minimum and maximum of
+// each pixel column of the visible range. The extremes of power of two runs
+// of samples are kept in a pyramid, so a column costs a logarithmic lookup
+// however many samples it covers. The points form a strip which the shader of
+// PolylineMaterial widens to the line width, with mitered joints.
+class PolylineGeometry : public Geometry {
+ private:
+  std::vector<QPointF> m_sample;
+  // Indices of the lowest and highest sample in each run, the first level
+  // covers runs of two.
+  std::vector<std::vector<uint>> m_minimum;
+  std::vector<std::vector<uint>> m_maximum;
+  qreal m_begin;
+  qreal m_end;
+  uint m_columns;
+  // Extent of the points, empty while lower is right of upper.
+  QPointF m_lower;
+  QPointF m_upper;
+  QSizeF m_padding;
+
+  void buildPyramid();
+  void extremes(uint begin, uint end, uint& minimum, uint& maximum) const;
+  void buildSegments(const std::vector<QPointF>&);
+  void updateBounds();
+
+ public:
+  PolylineGeometry();
+
+  inline const std::vector<QPointF>& samples() const { return m_sample; }
+  void setSamples(std::vector<QPointF>);
+
+  // Range of x across the given number of pixel columns. The segments are
+  // only rebuilt when the view changes.
+  void setView(qreal begin, qreal end, uint columns);
+
+  // How far the widened line reaches past the points, in the units of the
+  // samples. The bounding box is the points' grown by it.
+  inline QSizeF padding() const { return m_padding; }
+  void setPadding(QSizeF);
+};
+
+class PolylineMaterial : public Material {
+ private:
+  class PolylineShader : public Shader {
+   private:
+    int m_matrix;
+    int m_viewport;
+    int m_halfWidth;
+    int m_color;
+
+   protected:
+    void initialize() override;
+
+    inline void activate() override {}
+    inline void deactivate() override {}
+
+    const char* vertexShader() const override;
+    const char* fragmentShader() const override;
+
+    std::vector<std::string> attribute() const override;
+
+    void updateState(const Material*, const RenderState&) override;
+  };
+
+  QColor m_color;
+  float m_width;
+
+ public:
+  PolylineMaterial();
+
+  Shader* shader() const override;
+
+  inline QColor color() const { return m_color; }
+  inline void setColor(QColor c) { m_color = c; }
+
+  // In pixels.
+  inline float width() const { return m_width; }
+  inline void setWidth(float w) { m_width = w; }
+};
+
+class PolylineNode : public GeometryNode {
+ private:
+  PolylineGeometry m_polyline;
+  PolylineMaterial m_polylineMaterial;
+
+ public:
+  PolylineNode(Node* parent = nullptr);
+
+  inline PolylineGeometry* polyline() { return &m_polyline; }
+  inline PolylineMaterial* polylineMaterial() { return &m_polylineMaterial; }
+
+  void setSamples(std::vector<QPointF>);
+  void setView(qreal begin, qreal end, uint columns);
+
+  // Line width in pixels, with the size of a pixel in the units of the
+  // samples to pad the bounds by the longest miter.
+  void setWidth(float width, QSizeF pixel = QSizeF(1, 1));
+};
+}  // namespace SceneGraph
+
+#endif  // POLYLINE_HPP
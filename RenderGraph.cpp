@@ -0,0 +1,80 @@
+#include "RenderGraph.hpp"
+#include <QDebug>
+#include <algorithm>
+#include <cassert>
+#include "Node.hpp"
+
+namespace SceneGraph {
+
+namespace {
+
+const size_t FRAME_READER = size_t(-1);
+const size_t NO_READER = size_t(-2);
+}  // namespace
+
+RenderGraph::RenderGraph() : m_statistics() {}
+
+void RenderGraph::schedule(Node* node) {
+  auto it = m_state.find(node);
+  if (it != m_state.end()) {
+    if (it->second == State::Visiting) {
+      qDebug() << "[WARNING] Render pass reads its own output.";
+      m_statistics.cycles++;
+    }
+    return;
+  }
+  m_state[node] = State::Visiting;
+
+  std::vector<Node*> inputs;
+  node->prepare(inputs);
+
+  std::vector<size_t> index;
+  for (Node* input : inputs) {
+    assert(input->flag() & Node::UsePreprocess);
+    schedule(input);
+
+    auto i = m_index.find(input);
+    if (i != m_index.end() &&
+        std::find(index.begin(), index.end(), i->second) == index.end())
+      index.push_back(i->second);
+  }
+
+  m_state[node] = State::Scheduled;
+  m_index[node] = m_pass.size();
+  m_pass.push_back({node, std::move(index), NO_READER});
+}
+
+void RenderGraph::build(const std::vector<Node*>& frameInputs) {
+  m_pass.clear();
+  m_state.clear();
+  m_index.clear();
+  m_statistics = Statistics();
+
+  for (Node* node : frameInputs) schedule(node);
+
+  for (size_t i = 0; i < m_pass.size(); i++)
+    for (size_t input : m_pass[i].inputs) m_pass[input].lastReader = i;
+  for (Node* node : frameInputs) m_pass[m_index[node]].lastReader = FRAME_READER;
+
+  m_statistics.passes = uint(m_pass.size());
+}
+
+void RenderGraph::execute() {
+  for (size_t i = 0; i < m_pass.size(); i++) {
+    m_pass[i].node->preprocess();
+
+    for (size_t input : m_pass[i].inputs)
+      if (m_pass[input].lastReader == i) m_pass[input].node->releaseOutput();
+  }
+}
+
+void RenderGraph::finish() {
+  for (const Pass& pass : m_pass)
+    if (pass.lastReader == FRAME_READER || pass.lastReader == NO_READER)
+      pass.node->releaseOutput();
+
+  m_pass.clear();
+  m_state.clear();
+  m_index.clear();
+}
+}  // namespace SceneGraph
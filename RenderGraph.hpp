@@ -0,0 +1,56 @@
+#ifndef RENDERGRAPH_HPP
+#define RENDERGRAPH_HPP
+#include <QtGlobal>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace SceneGraph {
+
+class Node;
+
+// Offscreen passes of one frame. Passes are nodes flagged UsePreprocess which
+// were reached while gathering the frame, read by the materials it draws,
+// listed as inputs by another pass, or keep their output across frames;
+// transient ones nothing reads are skipped. Passes run after the passes they
+// read, and release their output once the last reader has run.
+class RenderGraph {
+ public:
+  struct Statistics {
+    uint passes;
+    uint cycles;
+  };
+
+ private:
+  enum class State { Visiting, Scheduled };
+
+  struct Pass {
+    Node* node;
+    std::vector<size_t> inputs;
+    size_t lastReader;
+  };
+
+  std::vector<Pass> m_pass;
+  std::unordered_map<Node*, State> m_state;
+  std::unordered_map<Node*, size_t> m_index;
+  Statistics m_statistics;
+
+  void schedule(Node*);
+
+ public:
+  RenderGraph();
+
+  // Orders the passes read by the frame, asking each of them for its inputs.
+  void build(const std::vector<Node*>& frameInputs);
+
+  // Runs the passes, releasing outputs only read by other passes.
+  void execute();
+
+  // Releases the outputs read by the frame, after it has been drawn.
+  void finish();
+
+  inline const Statistics& statistics() const { return m_statistics; }
+};
+}  // namespace SceneGraph
+
+#endif  // RENDERGRAPH_HPP
@@ -0,0 +1,97 @@
+#include "RenderTargetPool.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace SceneGraph {
+
+namespace {
+
+const uint MAXIMUM_IDLE_FRAMES = 60;
+const int MINIMUM_BUCKET_STEP = 16;
+
+// Rounds up to steps of an eighth of the enclosing power of two.
+int bucket(int size) {
+  int power = 1;
+  while (power < size) power <<= 1;
+  int step = std::max(MINIMUM_BUCKET_STEP, power / 8);
+  return (size + step - 1) / step * step;
+}
+}  // namespace
+
+RenderTargetPool::RenderTargetPool()
+    : m_statistics(), m_maximumIdleFrames(MAXIMUM_IDLE_FRAMES), m_frame() {}
+
+RenderTargetPool::~RenderTargetPool() {}
+
+QSize RenderTargetPool::bucket(QSize size) {
+  return QSize(SceneGraph::bucket(size.width()),
+               SceneGraph::bucket(size.height()));
+}
+
+size_t RenderTargetPool::byteSize(const Target& target) {
+  return size_t(target.fbo->width()) * size_t(target.fbo->height()) * 4;
+}
+
+QOpenGLFramebufferObject* RenderTargetPool::acquire(QSize size,
+                                                    GLenum format) {
+  assert(size.isValid());
+  size = bucket(size);
+
+  for (Target& target : m_target)
+    if (!target.used && target.format == format &&
+        target.fbo->size() == size) {
+      target.used = true;
+      m_statistics.reused++;
+      m_statistics.used++;
+      m_statistics.pooled--;
+      return target.fbo.get();
+    }
+
+  Target target;
+  if (format)
+    target.fbo = std::make_unique<QOpenGLFramebufferObject>(
+        size, QOpenGLFramebufferObject::NoAttachment, GL_TEXTURE_2D, format);
+  else
+    target.fbo = std::make_unique<QOpenGLFramebufferObject>(size);
+  target.format = format;
+  target.used = true;
+  target.frame = m_frame;
+
+  m_statistics.allocated++;
+  m_statistics.used++;
+  m_statistics.bytes += byteSize(target);
+
+  m_target.push_back(std::move(target));
+  return m_target.back().fbo.get();
+}
+
+void RenderTargetPool::release(QOpenGLFramebufferObject* fbo) {
+  if (!fbo) return;
+
+  auto it = std::find_if(
+      m_target.begin(), m_target.end(),
+      [fbo](const Target& target) { return target.fbo.get() == fbo; });
+  assert(it != m_target.end() && it->used);
+
+  it->used = false;
+  it->frame = m_frame;
+  m_statistics.used--;
+  m_statistics.pooled++;
+}
+
+void RenderTargetPool::collect(uint frame) {
+  m_frame = frame;
+
+  auto it = std::remove_if(m_target.begin(), m_target.end(),
+                           [this](const Target& target) {
+                             if (target.used ||
+                                 m_frame - target.frame <= m_maximumIdleFrames)
+                               return false;
+                             m_statistics.freed++;
+                             m_statistics.pooled--;
+                             m_statistics.bytes -= byteSize(target);
+                             return true;
+                           });
+  m_target.erase(it, m_target.end());
+}
+}  // namespace SceneGraph
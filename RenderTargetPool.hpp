@@ -0,0 +1,59 @@
+#ifndef RENDERTARGETPOOL_HPP
+#define RENDERTARGETPOOL_HPP
+#include <QOpenGLFramebufferObject>
+#include <memory>
+#include <vector>
+
+namespace SceneGraph {
+
+// Framebuffer objects shared by offscreen passes. Sizes are rounded up to
+// buckets so small size changes keep their target, and released targets are
+// kept for a few frames so they can be picked up again by anyone asking for
+// the same bucket and format.
+class RenderTargetPool {
+ public:
+  struct Statistics {
+    uint allocated;
+    uint reused;
+    uint freed;
+    uint used;
+    uint pooled;
+    size_t bytes;
+  };
+
+ private:
+  struct Target {
+    std::unique_ptr<QOpenGLFramebufferObject> fbo;
+    GLenum format;
+    bool used;
+    uint frame;
+  };
+
+  std::vector<Target> m_target;
+  Statistics m_statistics;
+  uint m_maximumIdleFrames;
+  uint m_frame;
+
+  static size_t byteSize(const Target&);
+
+ public:
+  RenderTargetPool();
+  ~RenderTargetPool();
+
+  static QSize bucket(QSize);
+
+  // Target of at least the given size; 0 selects the default format.
+  QOpenGLFramebufferObject* acquire(QSize, GLenum internalFormat = 0);
+  void release(QOpenGLFramebufferObject*);
+
+  // Frees targets released more than maximumIdleFrames() frames ago.
+  void collect(uint frame);
+
+  inline uint maximumIdleFrames() const { return m_maximumIdleFrames; }
+  inline void setMaximumIdleFrames(uint f) { m_maximumIdleFrames = f; }
+
+  inline const Statistics& statistics() const { return m_statistics; }
+};
+}  // namespace SceneGraph
+
+#endif  // RENDERTARGETPOOL_HPP
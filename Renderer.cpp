@@ -1,24 +1,122 @@
 #include "Renderer.hpp"
 #include <QColor>
-#include <QOpenGLTexture>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLTimerQuery>
 #include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
 #include <cassert>
+#include <iterator>
+#include <typeinfo>
 #include "Geometry.hpp"
+#include "GeometryCache.hpp"
 #include "Material.hpp"
 #include "Node.hpp"
+#include "RenderTargetPool.hpp"
+#include "ResourceRegistry.hpp"
 #include "Shader.hpp"
+#include "ShaderCache.hpp"
 #include "Window.hpp"
 
 namespace SceneGraph {
 
-Renderer::Renderer() : m_root(), m_frame(1) {
+namespace {
+
+const int MAX_SPLIT_ROUNDS = 8;
+const int TASKS_PER_THREAD = 4;
+const QRectF NDC_RECT(-1, -1, 2, 2);
+const qreal RESOLUTION_SCALE_STEP = 1.0 / 16;
+const int TIMER_QUERY_COUNT = 3;
+
+// Frames between sweeps of geometries dropped from the geometry cache.
+const uint GEOMETRY_COLLECT_INTERVAL = 64;
+const qreal DEFAULT_FRAME_TIME_TARGET = 14;
+const qreal DEFAULT_MINIMUM_RESOLUTION_SCALE = 0.5;
+
+void invalidateBounds(Node* root) {
+  root->invalidateBounds();
+  for (Node* node = root->firstChild(); node; node = node->next())
+    invalidateBounds(node);
+}
+
+uint64_t keyBits(uint64_t value, int bits) {
+  return value & ((uint64_t(1) << bits) - 1);
+}
+
+uint64_t keyBits(const void* ptr, int bits) {
+  return keyBits(uint64_t(reinterpret_cast<uintptr_t>(ptr)) >> 4, bits);
+}
+
+void collectReaders(
+    const Node* node,
+    std::unordered_map<const Node*, std::vector<const Node*>>& readers) {
+  if (node->type() == Node::Type::GeometryNode) {
+    const Material* material =
+        static_cast<const GeometryNode*>(node)->material();
+    std::vector<Node*> inputs;
+    if (material) material->inputs(inputs);
+    for (Node* input : inputs) readers[input].push_back(node);
+  }
+  for (Node* child = node->firstChild(); child; child = child->next())
+    collectReaders(child, readers);
+}
+
+// Whether the matrix keeps rectangles in the xy plane axis aligned.
+bool axisAligned(const QMatrix4x4& m) {
+  const float EPSILON = 1e-6f;
+  return std::abs(m(0, 1)) < EPSILON && std::abs(m(1, 0)) < EPSILON &&
+         std::abs(m(3, 0)) < EPSILON && std::abs(m(3, 1)) < EPSILON;
+}
+
+// Matrix from the node's space to the root's, which is returned in top.
+QMatrix4x4 rootMatrix(const Node* node, const Node*& top) {
+  QMatrix4x4 matrix;
+  for (; node; node = node->parent()) {
+    if (node->type() == Node::Type::TransformNode)
+      matrix = static_cast<const TransformNode*>(node)->matrix() * matrix;
+    top = node;
+  }
+  return matrix;
+}
+}  // namespace
+
+Renderer::Renderer()
+    : m_root(),
+      m_frame(1),
+      m_drawOrder(DrawOrder::Traversal),
+      m_parallelTraversal(true),
+      m_frustumCulling(),
+      m_occlusionPass(),
+      m_statistics(),
+      m_readersRoot(),
+      m_readersSerial(),
+      m_frameRequested(),
+      m_partialUpdate(PartialUpdate::Off),
+      m_fullDamage(true),
+      m_cullRect(NDC_RECT),
+      m_changed(true),
+      m_renderedSerial(),
+      m_frameElided(),
+      m_scissorEnabled(),
+      m_dynamicResolution(),
+      m_frameTimeTarget(DEFAULT_FRAME_TIME_TARGET),
+      m_minimumResolutionScale(DEFAULT_MINIMUM_RESOLUTION_SCALE),
+      m_resolutionScale(1),
+      m_timerQueryBegun() {
   initializeOpenGLFunctions();
   m_glVersion = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  m_registry = ResourceRegistry::acquire(m_glVersion);
+  m_occlusionCulling = std::make_unique<OcclusionCulling>();
+  m_renderTargetPool = std::make_shared<RenderTargetPool>();
 }
 
-Renderer::~Renderer() {}
+Renderer::~Renderer() { ResourceRegistry::release(m_registry); }
 
 void Renderer::updateItem(Item* item) {
+  if (item->m_itemNode) addDamage(item->m_itemNode.get());
+
   if (item->m_state & Item::ModelMatrixChanged) {
     item->m_itemNode->setMatrix(item->matrix());
     item->m_state &= ~Item::ModelMatrixChanged;
@@ -53,7 +151,13 @@ void Renderer::updateItem(Item* item) {
     item->m_node = item->synchronize(std::move(item->m_node));
     if (item->m_node && item->m_node->parent() == nullptr)
       item->m_itemNode->appendChild(item->m_node.get());
+    if (item->m_node) {
+      invalidateBounds(item->m_node.get());
+      item->m_node->markChanged();
+    }
   }
+
+  addDamage(item->m_itemNode.get());
 }
 
 void Renderer::updateNodes(Window* window) {
@@ -82,6 +186,7 @@ void Renderer::updateNodes(Window* window) {
 void Renderer::destroyNodes(Window* window) {
   for (auto& itemNode : window->m_destroyedItemNode) {
     assert(itemNode);
+    addDamage(itemNode.get());
     while (itemNode->firstChild())
       itemNode->removeChild(itemNode->firstChild());
   }
@@ -89,34 +194,443 @@ void Renderer::destroyNodes(Window* window) {
   window->m_destroyedNode.clear();
 }
 
+void Renderer::warmUpShaders(Window* window) {
+  QMutexLocker lock(renderMutex());
+  for (auto& factory : window->m_warmUpShader) {
+    Shader* shader = factory();
+    if (shader->initialized() || shader->linking() || shader->failed())
+      continue;
+
+    shader->compile(shaderCache());
+    if (Shader::parallelCompileSupported())
+      m_linkingShader.push_back(shader);
+    else
+      shader->initialize();
+  }
+  window->m_warmUpShader.clear();
+}
+
+void Renderer::finishLinkingShaders() {
+  QMutexLocker lock(renderMutex());
+  auto it = std::remove_if(m_linkingShader.begin(), m_linkingShader.end(),
+                           [](Shader* shader) {
+                             if (!shader->linking()) return true;
+                             if (!shader->linkCompleted()) return false;
+                             shader->initialize();
+                             return true;
+                           });
+  m_linkingShader.erase(it, m_linkingShader.end());
+  if (!m_linkingShader.empty()) requestFrame();
+}
+
+bool Renderer::prepareShader(Shader* shader) {
+  QMutexLocker lock(renderMutex());
+  if (shader->failed()) return false;
+  if (!shader->initialized()) {
+    shader->compile(shaderCache());
+    shader->initialize();
+  }
+  return shader->initialized();
+}
+
+QMutex* Renderer::renderMutex() const { return m_registry->renderMutex(); }
+
 void Renderer::render(Node* root, RenderState state) {
-  if (root->type() == Node::Type::GeometryNode) {
-    renderGeometryNode(static_cast<GeometryNode*>(root), state);
-  } else if (root->type() == Node::Type::TransformNode) {
-    TransformNode* node = static_cast<TransformNode*>(root);
-    state.setMatrix(state.matrix() * node->matrix());
+  submit(gather(root, state));
+}
+
+Renderer::DrawCommand Renderer::drawCommand(GeometryNode* node,
+                                            const RenderState& state) const {
+  // Runs on worker threads without a current context, so the shader is
+  // keyed by the material type that selects it.
+  Material* material = node->material();
+  uint64_t type = material ? typeid(*material).hash_code() : 0;
+  uint64_t key = keyBits(type, 24) << 40 | keyBits(material, 20) << 20 |
+                 keyBits(node->geometry(), 20);
+  return {node, state, key};
+}
+
+bool Renderer::visit(Node* node, RenderState& state, bool& cull,
+                     Task& task) const {
+  task.statistics.visited++;
+
+  // Ahead of culling, a pass's own bounds say nothing about where its output
+  // is shown.
+  if (node->flag() & Node::UsePreprocess) task.passes.push_back(node);
+
+  if (node->type() == Node::Type::TransformNode)
+    state.setMatrix(state.matrix() *
+                    static_cast<TransformNode*>(node)->matrix());
+
+  if (cull && node->type() != Node::Type::None) {
+    QRectF rect = state.clip() ? m_cullRect.intersected(state.clip()->rect)
+                               : m_cullRect;
+    Frustum::Result result =
+        Frustum(state.matrix(), rect).test(node->boundingBox());
+    if (result == Frustum::Result::Outside) {
+      task.statistics.culled++;
+      return false;
+    }
+    cull = result != Frustum::Result::Inside;
+  }
+
+  // Whatever lies outside a clip is culled, frustum culling or not.
+  if (node->type() == Node::Type::ClipNode) {
+    state.setClip(clip(static_cast<ClipNode*>(node), state));
+    if (state.clip()->rect.isEmpty()) {
+      task.statistics.culled++;
+      return false;
+    }
+    cull = true;
   }
 
+  if (m_occlusionPass && node->type() == Node::Type::TransformNode) {
+    BoundingBox box = node->boundingBox();
+    if (m_occlusionCulling->candidate(state.matrix(), box,
+                                      node->geometryCount())) {
+      task.queries.push_back({node, state.matrix(), box});
+      if (m_occlusionCulling->occluded(node)) {
+        task.statistics.occluded++;
+        return false;
+      }
+    }
+  }
+
+  if (node->type() == Node::Type::GeometryNode) {
+    GeometryNode* geometryNode = static_cast<GeometryNode*>(node);
+    task.list.push_back(drawCommand(geometryNode, state));
+    if (geometryNode->material())
+      geometryNode->material()->inputs(task.passes);
+  }
+
+  return true;
+}
+
+void Renderer::traverse(Node* root, RenderState state, bool cull,
+                        Task& task) const {
+  if (!visit(root, state, cull, task)) return;
+
   for (Node* node = root->firstChild(); node; node = node->next())
-    render(node, state);
+    traverse(node, state, cull, task);
 }
 
-void Renderer::nodeAdded(Node* node) {
-  if (node->flag() & Node::UsePreprocess) m_preprocess.insert(node);
+void Renderer::splitTasks(Node* root, RenderState state,
+                          std::vector<Task>& tasks) const {
+  // Expand the tree breadth first into subtree tasks, keeping them in
+  // traversal order so the merged lists match a sequential traversal. Nodes
+  // above the split are visited on the calling thread.
+  tasks.push_back({root, state, true, m_frustumCulling, {}, {}});
+
+  size_t target = size_t(QThread::idealThreadCount() * TASKS_PER_THREAD);
+  for (int round = 0; round < MAX_SPLIT_ROUNDS; round++) {
+    size_t subtrees = 0;
+    for (const Task& t : tasks)
+      if (t.subtree) subtrees++;
+    if (subtrees >= target) break;
+
+    std::vector<Task> expanded;
+    bool changed = false;
+    for (Task& t : tasks) {
+      if (!t.subtree || !t.node->firstChild()) {
+        expanded.push_back(std::move(t));
+        continue;
+      }
+
+      changed = true;
+      if (expanded.empty() || expanded.back().subtree)
+        expanded.push_back({nullptr, t.state, false, false, {}, {}});
+
+      RenderState s = t.state;
+      bool cull = t.cull;
+      if (!visit(t.node, s, cull, expanded.back())) continue;
+
+      for (Node* node = t.node->firstChild(); node; node = node->next())
+        expanded.push_back({node, s, true, cull, {}, {}});
+    }
+
+    tasks = std::move(expanded);
+    if (!changed) break;
+  }
 }
 
-void Renderer::nodeDestroyed(Node* node) {
-  if (node->flag() & Node::UsePreprocess) {
-    assert(m_preprocess.find(node) != m_preprocess.end());
-    m_preprocess.erase(node);
+Renderer::DrawList Renderer::gather(Node* root, RenderState state,
+                                    std::vector<Node*>* passes) {
+  DrawList list;
+
+  if (!m_parallelTraversal || QThread::idealThreadCount() <= 1) {
+    Task task{root, state, true, m_frustumCulling, {}, {}};
+    traverse(root, state, task.cull, task);
+    list = std::move(task.list);
+    std::move(task.queries.begin(), task.queries.end(),
+              std::back_inserter(m_occlusionQueries));
+    if (passes)
+      passes->insert(passes->end(), task.passes.begin(), task.passes.end());
+    m_statistics += task.statistics;
+  } else {
+    // Bounds are cached in TransformNodes on first use, so the caches are
+    // filled here rather than written by the workers. Clips cull even
+    // without frustum culling.
+    root->boundingBox();
+
+    std::vector<Task> tasks;
+    splitTasks(root, state, tasks);
+
+    QtConcurrent::blockingMap(tasks, [this](Task& t) {
+      if (t.subtree) traverse(t.node, t.state, t.cull, t);
+    });
+
+    size_t size = 0;
+    for (const Task& t : tasks) size += t.list.size();
+    list.reserve(size);
+    for (Task& t : tasks) {
+      std::move(t.list.begin(), t.list.end(), std::back_inserter(list));
+      std::move(t.queries.begin(), t.queries.end(),
+                std::back_inserter(m_occlusionQueries));
+      if (passes)
+        passes->insert(passes->end(), t.passes.begin(), t.passes.end());
+      m_statistics += t.statistics;
+    }
+  }
+
+  // Commands stay grouped by clip, switching clips costs more than any other
+  // state change.
+  if (m_drawOrder == DrawOrder::State)
+    std::stable_sort(list.begin(), list.end(),
+                     [](const DrawCommand& a, const DrawCommand& b) {
+                       std::less<const Clip*> less;
+                       if (a.state.clip() != b.state.clip())
+                         return less(a.state.clip(), b.state.clip());
+                       return a.key < b.key;
+                     });
+
+  return list;
+}
+
+void Renderer::submit(const DrawList& list) {
+  const Clip* current = nullptr;
+  for (const DrawCommand& command : list) {
+    if (command.state.clip() != current) {
+      current = command.state.clip();
+      applyClip(current);
+    }
+    renderGeometryNode(command.node, command.state);
+  }
+  if (current) applyClip(nullptr);
+}
+
+std::shared_ptr<const Clip> Renderer::clip(ClipNode* node,
+                                           const RenderState& state) const {
+  auto clip = std::make_shared<Clip>();
+  const Clip* parent = state.clip();
+  QRectF parentRect = parent ? parent->rect : NDC_RECT;
+
+  QRectF rect;
+  bool projected = node->clipBounds().project(state.matrix(), rect);
+
+  clip->parent = state.m_clip;
+  clip->node = node;
+  clip->matrix = state.matrix();
+  clip->stencil = !node->isRectangular() || !projected ||
+                  !axisAligned(state.matrix());
+  clip->rect = projected ? rect.intersected(parentRect) : parentRect;
+  clip->stencilDepth = (parent ? parent->stencilDepth : 0) + clip->stencil;
+  return clip;
+}
+
+void Renderer::applyClip(const Clip* clip) {
+  GLint view[4];
+  glGetIntegerv(GL_VIEWPORT, view);
+  QRect rect = m_scissorEnabled ? m_scissor
+                                : QRect(view[0], view[1], view[2], view[3]);
+  if (clip) rect = rect.intersected(pixelRect(clip->rect, false));
+
+  if (m_scissorEnabled || clip) {
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(rect.x(), rect.y(), std::max(rect.width(), 0),
+              std::max(rect.height(), 0));
+  } else {
+    glDisable(GL_SCISSOR_TEST);
+  }
+
+  // Targets without a stencil buffer are only clipped to the bounds of the
+  // stencil clips.
+  if (!clip || clip->stencilDepth == 0 || !hasStencilBuffer()) {
+    glDisable(GL_STENCIL_TEST);
+    glStencilMask(0xff);
+    return;
   }
+
+  std::vector<const Clip*> chain;
+  for (const Clip* c = clip; c; c = c->parent.get())
+    if (c->stencil) chain.push_back(c);
+  std::reverse(chain.begin(), chain.end());
+
+  Shader* shader = Shader::get<PositionShader>();
+  if (!prepareShader(shader)) return;
+
+  GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+  GLboolean depthMask;
+  glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+
+  glEnable(GL_STENCIL_TEST);
+  glStencilMask(0xff);
+  glClearStencil(0);
+  glClear(GL_STENCIL_BUFFER_BIT);
+
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  glDepthMask(GL_FALSE);
+  glDisable(GL_DEPTH_TEST);
+  QMutexLocker lock(renderMutex());
+  shader->bind();
+
+  // Each clip only increments where all the enclosing ones passed.
+  for (size_t i = 0; i < chain.size(); i++) {
+    glStencilFunc(GL_EQUAL, GLint(i), 0xff);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+    shader->updateState(nullptr, RenderState(chain[i]->matrix));
+
+    // Other attributes of the clip geometry have no location in the shader.
+    Geometry* g = chain[i]->node->stencilGeometry();
+    g->bindPosition(shader->attributeLocation()[0]);
+    if (g->indexCount())
+      glDrawElements(g->drawingMode(), g->indexCount(), g->indexType(),
+                     nullptr);
+    else
+      glDrawArrays(g->drawingMode(), 0, g->vertexCount());
+    g->release();
+  }
+
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glDepthMask(depthMask);
+  if (depthTest) glEnable(GL_DEPTH_TEST);
+
+  glStencilFunc(GL_EQUAL, GLint(chain.size()), 0xff);
+  glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+  glStencilMask(0);
+}
+
+bool Renderer::hasStencilBuffer() {
+  // GL_STENCIL_BITS is gone from core profiles, the window's format and the
+  // attachments of framebuffer objects tell instead.
+  QOpenGLContext* context = QOpenGLContext::currentContext();
+  GLint framebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+  if (GLuint(framebuffer) == context->defaultFramebufferObject())
+    return context->format().stencilBufferSize() > 0;
+
+  GLint type = GL_NONE;
+  glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT,
+                                        GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE,
+                                        &type);
+  return type != GL_NONE;
+}
+
+void Renderer::nodeDestroyed(Node* node) {
   if (node == m_root) m_root = nullptr;
+  m_occlusionCulling->nodeDestroyed(node);
+  removePreprocessNode(node);
+}
+
+void Renderer::addPreprocessNode(Node* node) {
+  m_preprocessNodes.push_back(node);
+}
+
+void Renderer::removePreprocessNode(Node* node) {
+  m_preprocessNodes.erase(
+      std::remove(m_preprocessNodes.begin(), m_preprocessNodes.end(), node),
+      m_preprocessNodes.end());
 }
 
 void Renderer::render() {
-  for (Node* node : m_preprocess) node->preprocess();
+  bool followUp = m_frameRequested;
+  m_statistics = Statistics();
+  m_frameRequested = false;
+
+  finishLinkingShaders();
+
+  bool partial = prepareFrameTarget();
+
+  // Nothing changed since the last frame, which is still on screen.
+  uint serial = m_root ? m_root->changeSerial() : 0;
+  m_frameElided = partial && !followUp && !m_changed && !m_fullDamage &&
+                  m_damage.isEmpty() && serial == m_renderedSerial;
+  m_changed = false;
+  m_renderedSerial = serial;
+  if (m_frameElided) {
+    presentFrameCache();
+    m_frame++;
+    return;
+  }
+
+  beginFrameTimer();
+  QRectF cullRect = partial && !m_fullDamage ? m_damage : NDC_RECT;
+
+  // Occlusion queries are only issued for whole frames, boxes outside the
+  // damaged area would be reported as hidden.
+  m_occlusionCulling->poll(m_frame);
+  m_occlusionPass = m_occlusionCulling->enabled() && cullRect == NDC_RECT;
+  m_cullRect = cullRect;
+  std::vector<Node*> passes;
+  DrawList list = gather(m_root, m_state, &passes);
+  m_cullRect = NDC_RECT;
+  m_occlusionPass = false;
+
+  for (Node* node : m_preprocessNodes)
+    if (!node->transientOutput()) passes.push_back(node);
+  m_renderGraph.build(passes);
+  m_renderGraph.execute();
+
+  // Passes may have damaged more of the window.
+  QRectF damage = m_fullDamage ? NDC_RECT : m_damage;
+  if (partial && !cullRect.contains(damage)) {
+    m_cullRect = damage;
+    list = gather(m_root, m_state);
+    m_cullRect = NDC_RECT;
+  }
+
+  if (m_frameCache) {
+    m_frameCache->bind();
+    glViewport(0, 0, m_frameCache->width(), m_frameCache->height());
+  }
+  if (partial) {
+    m_scissorEnabled = true;
+    m_scissor = damageRect();
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(m_scissor.x(), m_scissor.y(), m_scissor.width(),
+              m_scissor.height());
+  }
 
-  render(m_root, m_state);
+  if (!partial || !damage.isEmpty()) {
+    beginFrame();
+    submit(list);
+  }
+
+  if (partial) {
+    m_scissorEnabled = false;
+    glDisable(GL_SCISSOR_TEST);
+  }
+  if (m_frameCache) {
+    m_frameCache->release();
+    glViewport(m_viewport.x(), m_viewport.y(), m_viewport.width(),
+               m_viewport.height());
+  }
+  presentFrameCache();
+  endFrameTimer();
+
+  m_renderGraph.finish();
+  m_damage = QRectF();
+  m_fullDamage = false;
+  // No queries while the box shader is still linking, or when it failed.
+  if (!m_occlusionQueries.empty() &&
+      prepareShader(m_occlusionCulling->shader())) {
+    QMutexLocker lock(renderMutex());
+    m_occlusionCulling->issue(m_occlusionQueries);
+  }
+  m_occlusionQueries.clear();
+
+  m_renderTargetPool->collect(m_frame);
+  if (m_frame % GEOMETRY_COLLECT_INTERVAL == 0)
+    m_registry->geometryCache()->collect();
   m_frame++;
 }
 
@@ -126,13 +640,179 @@ void Renderer::synchronize(Window* window) {
     window->update();
   }
 
+  if (m_state.matrix() != window->projection()) invalidateFrame();
   m_state.setMatrix(window->projection());
 
+  warmUpShaders(window);
   updateNodes(window);
   destroyNodes(window);
 }
 
-void Renderer::setSize(QSize size) { m_size = size; }
+void Renderer::setSize(QSize size) {
+  m_size = size;
+  invalidateFrame();
+}
+
+void Renderer::beginFrame() {}
+
+void Renderer::addDamage(const Node* node) {
+  m_changed = true;
+  if (m_partialUpdate == PartialUpdate::Off || !node || !m_root) return;
+
+  if (node->flag() & Node::UsePreprocess)
+    for (const Node* reader : readers(node)) addDamage(reader);
+
+  const Node* top = nullptr;
+  QMatrix4x4 matrix = rootMatrix(node, top);
+  if (top != m_root) return;
+
+  addDamage(m_state.matrix() * matrix, node->boundingBox());
+}
+
+const std::vector<const Node*>& Renderer::readers(const Node* pass) {
+  // Rebuilt whenever the tree changed, materials are set through it.
+  if (m_root != m_readersRoot || m_root->changeSerial() != m_readersSerial) {
+    m_readers.clear();
+    collectReaders(m_root, m_readers);
+    m_readersRoot = m_root;
+    m_readersSerial = m_root->changeSerial();
+  }
+
+  static const std::vector<const Node*> none;
+  auto it = m_readers.find(pass);
+  return it != m_readers.end() ? it->second : none;
+}
+
+void Renderer::addDamage(const QMatrix4x4& matrix, const BoundingBox& box) {
+  if (box.isEmpty()) return;
+
+  QRectF rect;
+  if (!box.project(matrix, rect)) return invalidateFrame();
+
+  rect = rect.intersected(NDC_RECT);
+  if (!rect.isEmpty()) m_damage = m_damage.united(rect);
+}
+
+Renderer::PartialUpdate Renderer::partialUpdateMode() const {
+  if (m_partialUpdate != PartialUpdate::PreservedBuffer) return m_partialUpdate;
+
+  QSurfaceFormat format = QOpenGLContext::currentContext()->format();
+  return format.swapBehavior() == QSurfaceFormat::SingleBuffer
+             ? PartialUpdate::PreservedBuffer
+             : PartialUpdate::CachedFrame;
+}
+
+bool Renderer::prepareFrameTarget() {
+  GLint view[4];
+  glGetIntegerv(GL_VIEWPORT, view);
+  m_viewport = QRect(view[0], view[1], view[2], view[3]);
+
+  if (!m_dynamicResolution) m_resolutionScale = 1;
+  PartialUpdate mode = partialUpdateMode();
+  bool target = QOpenGLFramebufferObject::hasOpenGLFramebufferBlit() &&
+                (mode == PartialUpdate::CachedFrame || m_dynamicResolution);
+  if (!target) {
+    m_frameCache = nullptr;
+    return mode == PartialUpdate::PreservedBuffer;
+  }
+
+  QSize size = (QSizeF(m_viewport.size()) * m_resolutionScale).toSize();
+  size = size.expandedTo(QSize(1, 1));
+  if (!m_frameCache || m_frameCache->size() != size) {
+    m_frameCache = std::make_unique<QOpenGLFramebufferObject>(
+        size, QOpenGLFramebufferObject::CombinedDepthStencil);
+    invalidateFrame();
+  }
+
+  return m_partialUpdate != PartialUpdate::Off;
+}
+
+void Renderer::presentFrameCache() {
+  if (!m_frameCache) return;
+
+  QRect rect(QPoint(), m_frameCache->size());
+  QOpenGLFramebufferObject::blitFramebuffer(
+      nullptr, m_viewport, m_frameCache.get(), rect, GL_COLOR_BUFFER_BIT,
+      rect.size() == m_viewport.size() ? GL_NEAREST : GL_LINEAR);
+}
+
+void Renderer::beginFrameTimer() {
+  m_timerQueryBegun = false;
+  if (!m_dynamicResolution) return;
+
+  if (m_timerQuery.empty()) {
+    for (int i = 0; i < TIMER_QUERY_COUNT; i++) {
+      auto query = std::make_unique<QOpenGLTimerQuery>();
+      if (!query->create()) break;
+      m_timerQuery.push_back({std::move(query), false});
+    }
+    if (m_timerQuery.size() < size_t(TIMER_QUERY_COUNT)) m_timerQuery.clear();
+  }
+
+  if (m_timerQuery.empty()) {
+    // Without timer queries the interval between frames stands in for the
+    // GPU time, which only works while frames are rendered back to back.
+    qint64 interval = m_frameTimer.isValid() ? m_frameTimer.restart() : 0;
+    if (!m_frameTimer.isValid()) m_frameTimer.start();
+    if (interval > 0 && interval < 4 * m_frameTimeTarget)
+      updateResolutionScale(interval);
+    return;
+  }
+
+  // A slot whose result is still outstanding skips timing this frame.
+  TimerQuery& query = m_timerQuery[m_frame % m_timerQuery.size()];
+  if (query.pending) {
+    if (!query.query->isResultAvailable()) return;
+    updateResolutionScale(query.query->waitForResult() / 1e6);
+  }
+  query.query->begin();
+  query.pending = true;
+  m_timerQueryBegun = true;
+}
+
+void Renderer::endFrameTimer() {
+  if (!m_timerQueryBegun) return;
+
+  m_timerQuery[m_frame % m_timerQuery.size()].query->end();
+  m_timerQueryBegun = false;
+}
+
+void Renderer::updateResolutionScale(qreal frameTime) {
+  // Pixel count follows the square of the scale. Going down jumps close to
+  // the target at once, going up is step by step to avoid oscillating.
+  qreal scale = m_resolutionScale;
+  if (frameTime > m_frameTimeTarget) {
+    qreal wanted = scale * std::sqrt(m_frameTimeTarget / frameTime);
+    scale = std::min(scale - RESOLUTION_SCALE_STEP,
+                     std::floor(wanted / RESOLUTION_SCALE_STEP) *
+                         RESOLUTION_SCALE_STEP);
+  } else if (frameTime < 0.8 * m_frameTimeTarget) {
+    scale += RESOLUTION_SCALE_STEP;
+  }
+  m_resolutionScale = qBound(m_minimumResolutionScale, scale, qreal(1));
+}
+
+QRect Renderer::damageRect() {
+  QRectF damage = m_fullDamage ? NDC_RECT : m_damage;
+  if (damage.isEmpty()) return QRect();
+
+  // Rounded out, with a pixel of margin for antialiased edges.
+  return pixelRect(damage, true);
+}
+
+QRect Renderer::pixelRect(const QRectF& ndc, bool roundOut) {
+  GLint view[4];
+  glGetIntegerv(GL_VIEWPORT, view);
+  qreal left = view[0] + (ndc.left() + 1) / 2 * view[2];
+  qreal right = view[0] + (ndc.right() + 1) / 2 * view[2];
+  qreal bottom = view[1] + (ndc.top() + 1) / 2 * view[3];
+  qreal top = view[1] + (ndc.bottom() + 1) / 2 * view[3];
+  if (roundOut)
+    return QRect(QPoint(int(std::floor(left)) - 1, int(std::floor(bottom)) - 1),
+                 QPoint(int(std::ceil(right)), int(std::ceil(top))));
+  return QRect(QPoint(qRound(left), qRound(bottom)),
+               QPoint(qRound(right) - 1, qRound(top) - 1));
+}
 
 void Renderer::setRoot(Item* item) {
   if (item == nullptr) {
@@ -151,17 +831,17 @@ void Renderer::setRoot(Item* item) {
 }
 
 QOpenGLTexture* Renderer::texture(const char* path) {
-  if (m_texture.find(path) == m_texture.end()) {
-    QImage image(path);
-    assert(!image.isNull());
-
-    auto texture = std::make_unique<QOpenGLTexture>(image);
-    texture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
-    m_texture[path] = std::move(texture);
-  }
-
-  return m_texture[path].get();
+  return m_registry->texture(path);
 }
 
+ShaderCache* Renderer::shaderCache() const { return m_registry->shaderCache(); }
+
 RenderState::RenderState(QMatrix4x4 m) : m_matrix(m) {}
+
+Renderer::Statistics& Renderer::Statistics::operator+=(const Statistics& s) {
+  visited += s.visited;
+  culled += s.culled;
+  occluded += s.occluded;
+  return *this;
+}
 }  // namespace SceneGraph
@@ -2,12 +2,21 @@
 #define RENDERER_HPP
 #include <QMatrix4x4>
 #include <QOpenGLFunctions>
+#include <QElapsedTimer>
+#include <QRect>
+#include <QRectF>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
+#include "OcclusionCulling.hpp"
+#include "RenderGraph.hpp"
 
+class QMutex;
 class QOpenGLTexture;
+class QOpenGLFramebufferObject;
+class QOpenGLTimerQuery;
 
 namespace SceneGraph {
 
@@ -15,43 +24,170 @@ class Node;
 class GeometryNode;
 class Item;
 class Window;
+class Shader;
+class ShaderCache;
+class ResourceRegistry;
+class RenderTargetPool;
+
+class ClipNode;
+
+// Clip in effect for a draw. The rectangle, in normalized device
+// coordinates, also bounds the stencil clips up the chain.
+struct Clip {
+  std::shared_ptr<const Clip> parent;
+  ClipNode* node;
+  QMatrix4x4 matrix;
+  QRectF rect;
+  bool stencil;
+  uint stencilDepth;
+};
 
 class RenderState {
  private:
   friend class Renderer;
 
   QMatrix4x4 m_matrix;
+  std::shared_ptr<const Clip> m_clip;
 
   inline void setMatrix(QMatrix4x4 m) { m_matrix = m; }
+  inline void setClip(std::shared_ptr<const Clip> c) { m_clip = std::move(c); }
 
  public:
   RenderState(QMatrix4x4 = QMatrix4x4());
 
   inline const QMatrix4x4& matrix() const { return m_matrix; }
+  inline const Clip* clip() const { return m_clip.get(); }
 };
 
 class Renderer : public QOpenGLFunctions {
+ public:
+  enum class DrawOrder { Traversal, State };
+
+  // Redrawing only the damaged part of the window needs the rest of the last
+  // frame, either kept by the surface across swaps or in a cached copy. Qt
+  // only grants preserved buffers as single buffered surfaces, others fall
+  // back to the cached copy.
+  enum class PartialUpdate { Off, PreservedBuffer, CachedFrame };
+
+  struct DrawCommand {
+    GeometryNode* node;
+    RenderState state;
+    uint64_t key;
+  };
+
+  using DrawList = std::vector<DrawCommand>;
+
+  struct Statistics {
+    uint visited;
+    uint culled;
+    uint occluded;
+
+    Statistics& operator+=(const Statistics&);
+  };
+
  private:
   friend class Node;
 
+  struct Task {
+    Node* node;
+    RenderState state;
+    bool subtree;
+    bool cull;
+    DrawList list;
+    std::vector<OcclusionCulling::Candidate> queries;
+    Statistics statistics;
+    std::vector<Node*> passes;
+  };
+
+  struct TimerQuery {
+    std::unique_ptr<QOpenGLTimerQuery> query;
+    bool pending;
+  };
+
   Node* m_root;
   RenderState m_state;
   QSize m_size;
   uint m_frame;
-  std::unordered_map<std::string, std::unique_ptr<QOpenGLTexture>> m_texture;
-  std::unordered_set<Node*> m_preprocess;
+  RenderGraph m_renderGraph;
   std::string m_glVersion;
+  ResourceRegistry* m_registry;
+  DrawOrder m_drawOrder;
+  bool m_parallelTraversal;
+  bool m_frustumCulling;
+  bool m_occlusionPass;
+  std::unique_ptr<OcclusionCulling> m_occlusionCulling;
+  std::vector<OcclusionCulling::Candidate> m_occlusionQueries;
+  Statistics m_statistics;
+  std::vector<Shader*> m_linkingShader;
+  std::vector<Node*> m_preprocessNodes;
+  std::unordered_map<const Node*, std::vector<const Node*>> m_readers;
+  const Node* m_readersRoot;
+  uint m_readersSerial;
+  std::shared_ptr<RenderTargetPool> m_renderTargetPool;
+  bool m_frameRequested;
+  PartialUpdate m_partialUpdate;
+  QRectF m_damage;
+  bool m_fullDamage;
+  QRectF m_cullRect;
+  std::unique_ptr<QOpenGLFramebufferObject> m_frameCache;
+  bool m_changed;
+  uint m_renderedSerial;
+  bool m_frameElided;
+  QRect m_viewport;
+  bool m_scissorEnabled;
+  QRect m_scissor;
+  bool m_dynamicResolution;
+  qreal m_frameTimeTarget;
+  qreal m_minimumResolutionScale;
+  qreal m_resolutionScale;
+  std::vector<TimerQuery> m_timerQuery;
+  bool m_timerQueryBegun;
+  QElapsedTimer m_frameTimer;
 
   void updateItem(Item*);
   void updateNodes(Window*);
   void destroyNodes(Window*);
+  void warmUpShaders(Window*);
+  void finishLinkingShaders();
 
-  void nodeAdded(Node*);
   void nodeDestroyed(Node*);
 
+  // Nodes flagged UsePreprocess, whether or not the frame reaches them.
+  void addPreprocessNode(Node*);
+  void removePreprocessNode(Node*);
+
+  bool visit(Node*, RenderState&, bool& cull, Task&) const;
+  void splitTasks(Node*, RenderState, std::vector<Task>&) const;
+  void traverse(Node*, RenderState, bool cull, Task&) const;
+  DrawCommand drawCommand(GeometryNode*, const RenderState&) const;
+  std::shared_ptr<const Clip> clip(ClipNode*, const RenderState&) const;
+  void applyClip(const Clip*);
+  bool hasStencilBuffer();
+  QRect pixelRect(const QRectF& ndc, bool roundOut);
+
+  void addDamage(const QMatrix4x4&, const BoundingBox&);
+  // GeometryNodes in the window's tree whose materials sample the pass.
+  const std::vector<const Node*>& readers(const Node* pass);
+  PartialUpdate partialUpdateMode() const;
+  bool prepareFrameTarget();
+  void beginFrameTimer();
+  void endFrameTimer();
+  void updateResolutionScale(qreal frameTime);
+  QRect damageRect();
+  void presentFrameCache();
+
  protected:
   virtual void renderGeometryNode(GeometryNode* node, const RenderState&) = 0;
 
+  bool prepareShader(Shader*);
+  // Held from binding a shared program until its draws are done, as other
+  // windows of the share group set its uniforms too.
+  QMutex* renderMutex() const;
+
+  // Called before the frame's draw commands are submitted, with the scissor
+  // test restricting drawing to the damaged area.
+  virtual void beginFrame();
+
  public:
   Renderer();
   virtual ~Renderer();
@@ -59,6 +195,69 @@ class Renderer : public QOpenGLFunctions {
   virtual void render();
   void render(Node*, RenderState);
 
+  // Collects the draw commands of a subtree, and when asked to the render
+  // passes it reaches or whose output its materials read.
+  DrawList gather(Node*, RenderState, std::vector<Node*>* passes = nullptr);
+  void submit(const DrawList&);
+
+  inline DrawOrder drawOrder() const { return m_drawOrder; }
+  inline void setDrawOrder(DrawOrder o) { m_drawOrder = o; }
+
+  inline bool parallelTraversal() const { return m_parallelTraversal; }
+  inline void setParallelTraversal(bool e) { m_parallelTraversal = e; }
+
+  // Off by default. Culling takes the bounds of geometries from their first
+  // attribute when it holds floats, so every geometry whose first attribute
+  // isn't its position, or whose shader moves vertices, needs
+  // Geometry::setBoundingBox() first.
+  inline bool frustumCulling() const { return m_frustumCulling; }
+  inline void setFrustumCulling(bool e) { m_frustumCulling = e; }
+
+  inline OcclusionCulling* occlusionCulling() const {
+    return m_occlusionCulling.get();
+  }
+
+  inline const Statistics& statistics() const { return m_statistics; }
+
+  inline PartialUpdate partialUpdate() const { return m_partialUpdate; }
+  inline void setPartialUpdate(PartialUpdate p) { m_partialUpdate = p; }
+
+  // Marks the window area covered by the subtree, in its current position,
+  // for redrawing. Subtrees not drawn into the window are ignored, for passes
+  // the nodes showing their output are marked.
+  void addDamage(const Node*);
+  inline void invalidateFrame() { m_fullDamage = true; }
+
+  // Whether the last frame was skipped since nothing changed. Needs partial
+  // updates, which keep the previous frame around.
+  inline bool frameElided() const { return m_frameElided; }
+
+  // Renders into a target scaled to keep the GPU frame time, in
+  // milliseconds, under the target, and upsamples it to the window.
+  // Offscreen textures follow the same scale.
+  inline bool dynamicResolution() const { return m_dynamicResolution; }
+  inline void setDynamicResolution(bool e) { m_dynamicResolution = e; }
+
+  inline qreal frameTimeTarget() const { return m_frameTimeTarget; }
+  inline void setFrameTimeTarget(qreal t) { m_frameTimeTarget = t; }
+
+  inline qreal minimumResolutionScale() const {
+    return m_minimumResolutionScale;
+  }
+  inline void setMinimumResolutionScale(qreal s) {
+    m_minimumResolutionScale = s;
+  }
+
+  inline qreal resolutionScale() const { return m_resolutionScale; }
+
+  inline const RenderGraph& renderGraph() const { return m_renderGraph; }
+
+  // Shared so that targets held by nodes outliving the renderer can be
+  // recognized as gone.
+  inline std::shared_ptr<RenderTargetPool> renderTargetPool() const {
+    return m_renderTargetPool;
+  }
+
   void synchronize(Window* window);
 
   void setSize(QSize);
@@ -70,7 +269,16 @@ class Renderer : public QOpenGLFunctions {
 
   QOpenGLTexture* texture(const char* path);
 
+  ShaderCache* shaderCache() const;
+
+  inline ResourceRegistry* registry() const { return m_registry; }
+
   inline uint frame() const { return m_frame; }
+
+  // Asks for another frame after the current one, e.g. while work started
+  // on the GPU is still in flight.
+  inline void requestFrame() { m_frameRequested = true; }
+  inline bool frameRequested() const { return m_frameRequested; }
   inline std::string glVersion() const { return m_glVersion; }
 };
 }  // namespace SceneGraph
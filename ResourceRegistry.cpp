@@ -0,0 +1,97 @@
+#include "ResourceRegistry.hpp"
+#include <QImage>
+#include <QOpenGLContext>
+#include <QOpenGLTexture>
+#include <atomic>
+#include <cassert>
+#include "GeometryCache.hpp"
+#include "GlyphAtlas.hpp"
+#include "Shader.hpp"
+#include "ShaderCache.hpp"
+
+namespace SceneGraph {
+
+namespace {
+
+QMutex registryMutex;
+std::unordered_map<QOpenGLContextGroup*, ResourceRegistry*> registry;
+
+// Lookups happen for every draw, threads remember their last registry until
+// any registry is created or destroyed.
+std::atomic<uint> generation(1);
+thread_local QOpenGLContextGroup* lastGroup;
+thread_local ResourceRegistry* lastRegistry;
+thread_local uint lastGeneration;
+}  // namespace
+
+ResourceRegistry::ResourceRegistry(QOpenGLContextGroup* group,
+                                   const std::string& driver)
+    : m_group(group),
+      m_users(),
+      m_shaderCache(std::make_unique<ShaderCache>(driver)),
+      m_geometryCache(std::make_unique<GeometryCache>()) {}
+
+ResourceRegistry::~ResourceRegistry() {}
+
+ResourceRegistry* ResourceRegistry::current() {
+  QOpenGLContext* context = QOpenGLContext::currentContext();
+  assert(context);
+
+  QOpenGLContextGroup* group = context->shareGroup();
+  if (group == lastGroup && lastGeneration == generation.load())
+    return lastRegistry;
+
+  QMutexLocker lock(&registryMutex);
+  auto it = registry.find(group);
+  assert(it != registry.end());
+
+  lastGroup = group;
+  lastRegistry = it->second;
+  lastGeneration = generation.load();
+  return lastRegistry;
+}
+
+ResourceRegistry* ResourceRegistry::acquire(const std::string& driver) {
+  QOpenGLContextGroup* group = QOpenGLContext::currentContext()->shareGroup();
+
+  QMutexLocker lock(&registryMutex);
+  ResourceRegistry*& r = registry[group];
+  if (!r) {
+    r = new ResourceRegistry(group, driver);
+    generation++;
+  }
+
+  r->m_users++;
+  return r;
+}
+
+void ResourceRegistry::release(ResourceRegistry* r) {
+  QMutexLocker lock(&registryMutex);
+  if (--r->m_users > 0) return;
+
+  registry.erase(r->m_group);
+  generation++;
+  delete r;
+}
+
+QOpenGLTexture* ResourceRegistry::texture(const char* path) {
+  QMutexLocker lock(&m_mutex);
+
+  std::unique_ptr<QOpenGLTexture>& texture = m_texture[path];
+  if (!texture) {
+    QImage image(path);
+    assert(!image.isNull());
+
+    texture = std::make_unique<QOpenGLTexture>(image);
+    texture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+  }
+
+  return texture.get();
+}
+
+GlyphAtlas* ResourceRegistry::glyphAtlas() {
+  QMutexLocker lock(&m_mutex);
+  if (!m_glyphAtlas) m_glyphAtlas = std::make_unique<GlyphAtlas>();
+  return m_glyphAtlas.get();
+}
+}  // namespace SceneGraph
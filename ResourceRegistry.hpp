@@ -0,0 +1,67 @@
+#ifndef RESOURCEREGISTRY_HPP
+#define RESOURCEREGISTRY_HPP
+#include <QMutex>
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+
+class QOpenGLContextGroup;
+class QOpenGLTexture;
+
+namespace SceneGraph {
+
+class Shader;
+class ShaderCache;
+class GlyphAtlas;
+class GeometryCache;
+
+// GL resources shared by all renderers whose contexts are in one share group.
+// Renderers on different threads serialize on renderMutex() while they link
+// the shared programs and while they set uniforms and draw with them, since
+// uniform values are program state. The rest of their frames run in parallel.
+class ResourceRegistry {
+ private:
+  QOpenGLContextGroup* m_group;
+  uint m_users;
+  QMutex m_mutex;
+  QMutex m_renderMutex;
+  std::unordered_map<std::type_index, std::unique_ptr<Shader>> m_shader;
+  std::unordered_map<std::string, std::unique_ptr<QOpenGLTexture>> m_texture;
+  std::unique_ptr<ShaderCache> m_shaderCache;
+  std::unique_ptr<GlyphAtlas> m_glyphAtlas;
+  std::unique_ptr<GeometryCache> m_geometryCache;
+
+  ResourceRegistry(QOpenGLContextGroup*, const std::string& driver);
+
+ public:
+  ~ResourceRegistry();
+
+  // Registry of the current context's share group.
+  static ResourceRegistry* current();
+
+  static ResourceRegistry* acquire(const std::string& driver);
+  static void release(ResourceRegistry*);
+
+  template <class T>
+  T* shader() {
+    QMutexLocker lock(&m_mutex);
+    std::unique_ptr<Shader>& shader = m_shader[typeid(T)];
+    if (!shader) shader = std::make_unique<T>();
+    return static_cast<T*>(shader.get());
+  }
+
+  QOpenGLTexture* texture(const char* path);
+
+  // Created on first use, needs a current context.
+  GlyphAtlas* glyphAtlas();
+
+  inline ShaderCache* shaderCache() const { return m_shaderCache.get(); }
+  inline GeometryCache* geometryCache() const {
+    return m_geometryCache.get();
+  }
+  inline QMutex* renderMutex() { return &m_renderMutex; }
+};
+}  // namespace SceneGraph
+
+#endif  // RESOURCEREGISTRY_HPP
@@ -1,4 +1,4 @@
-QT = core gui quick
+QT = core gui quick concurrent
 CONFIG += c++14
 CONFIG -= debug_and_release
 TARGET = SceneGraph
@@ -9,27 +9,62 @@ android: QMAKE_CXXFLAGS += -std=c++14
 
 SOURCES += \
     BaseObject.cpp \
+    BoundingBox.cpp \
     Camera.cpp \
     DefaultRenderer.cpp \
     Geometry.cpp \
+    GeometryCache.cpp \
+    GlyphAtlas.cpp \
     Item.cpp \
     Material.cpp \
+    MeshFile.cpp \
+    MeshOptimizer.cpp \
     Node.cpp \
+    OcclusionCulling.cpp \
     Renderer.cpp \
+    RenderGraph.cpp \
+    RenderTargetPool.cpp \
+    ResourceRegistry.cpp \
     Shader.cpp \
+    ShaderCache.cpp \
     Window.cpp \
+    ParticleSystem.cpp \
+    Polyline.cpp \
+    Shape.cpp \
+    VertexFormat.cpp \
+    Tessellator.cpp \
+    Text.cpp \
+    UploadService.cpp \
     ShaderSource.cpp
 
 HEADERS += \
     BaseObject.hpp \
+    BoundingBox.hpp \
     Camera.hpp \
     Geometry.hpp \
+    GeometryCache.hpp \
+    GlyphAtlas.hpp \
     Item.hpp \
     Material.hpp \
+    MeshFile.hpp \
+    MeshOptimizer.hpp \
     Node.hpp \
+    OcclusionCulling.hpp \
+    RenderGraph.hpp \
+    RenderTargetPool.hpp \
+    ResourceRegistry.hpp \
     Shader.hpp \
+    ShaderCache.hpp \
     Window.hpp \
     ShaderSource.hpp \
+    ParticleSystem.hpp \
+    Polyline.hpp \
+    Shape.hpp \
+    VertexFormat.hpp \
+    Tessellator.hpp \
+    Text.hpp \
+    TypedGeometry.hpp \
+    UploadService.hpp \
     DefaultRenderer.hpp \
     Renderer.hpp
 
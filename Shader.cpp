@@ -1,19 +1,102 @@
 #include "Shader.hpp"
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <algorithm>
 #include <cassert>
+#include <iterator>
+#include "Renderer.hpp"
+#include "ShaderCache.hpp"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
 namespace SceneGraph {
 
-Shader::Shader() : m_initialized() {}
+Shader::Shader()
+    : m_initialized(),
+      m_linking(),
+      m_failed(),
+      m_cache(),
+      m_cached() {
+  std::fill(std::begin(m_attributeLocation), std::end(m_attributeLocation),
+            -1);
+}
+
+void Shader::compile(ShaderCache* cache) {
+  if (m_initialized || m_linking || m_failed) return;
+
+  QOpenGLExtraFunctions* gl =
+      QOpenGLContext::currentContext()->extraFunctions();
+
+  program()->create();
+  GLuint id = program()->programId();
+
+  m_cache = cache;
+  if (m_cache) {
+    m_cacheKey = m_cache->key(vertexShader(), fragmentShader());
+    m_cached = m_cache->load(id, m_cacheKey);
+    if (m_cached) {
+      m_linking = true;
+      return;
+    }
+  }
+
+  // Shaders are attached behind QOpenGLShaderProgram's back, so that link()
+  // only picks up the status of the link started here.
+  m_vertex = std::make_unique<QOpenGLShader>(QOpenGLShader::Vertex);
+  m_fragment = std::make_unique<QOpenGLShader>(QOpenGLShader::Fragment);
+  if (!m_vertex->compileSourceCode(vertexShader()) ||
+      !m_fragment->compileSourceCode(fragmentShader())) {
+    qDebug() << "[FAIL] Failed to compile shader." << m_vertex->log()
+             << m_fragment->log();
+    m_vertex = nullptr;
+    m_fragment = nullptr;
+    m_failed = true;
+    return;
+  }
+
+  gl->glAttachShader(id, m_vertex->shaderId());
+  gl->glAttachShader(id, m_fragment->shaderId());
+  if (m_cache) m_cache->prepare(id);
+  gl->glLinkProgram(id);
+
+  m_linking = true;
+}
+
+bool Shader::linkCompleted() {
+  if (!m_linking || !parallelCompileSupported()) return true;
+
+  GLint completed = 0;
+  QOpenGLContext::currentContext()->functions()->glGetProgramiv(
+      program()->programId(), GL_COMPLETION_STATUS_KHR, &completed);
+  return completed;
+}
 
 void Shader::initialize() {
-  program()->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShader());
-  program()->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShader());
+  compile(m_cache);
+  if (m_failed) return;
 
-  if (!program()->link()) {
-    qDebug() << "[FAIL] Failed to link shader.";
-    exit(1);
+  m_linking = false;
+  bool linked = program()->link();
+
+  if (m_vertex) {
+    QOpenGLExtraFunctions* gl =
+        QOpenGLContext::currentContext()->extraFunctions();
+    gl->glDetachShader(program()->programId(), m_vertex->shaderId());
+    gl->glDetachShader(program()->programId(), m_fragment->shaderId());
+    m_vertex = nullptr;
+    m_fragment = nullptr;
   }
 
+  if (!linked) {
+    qDebug() << "[FAIL] Failed to link shader." << program()->log();
+    m_failed = true;
+    return;
+  }
+
+  if (m_cache && !m_cached) m_cache->store(program()->programId(), m_cacheKey);
+
   int id = 0;
   for (const std::string& name : attribute()) {
     m_attributeLocation[id] = program()->attributeLocation(name.c_str());
@@ -23,4 +106,36 @@ void Shader::initialize() {
 
   m_initialized = true;
 }
+
+bool Shader::parallelCompileSupported() {
+  QOpenGLContext* context = QOpenGLContext::currentContext();
+  return context->hasExtension("GL_KHR_parallel_shader_compile") ||
+         context->hasExtension("GL_ARB_parallel_shader_compile");
+}
+
+PositionShader::PositionShader() : m_matrix(-1) {}
+
+void PositionShader::initialize() {
+  Shader::initialize();
+
+  m_matrix = program()->uniformLocation("matrix");
+}
+
+const char* PositionShader::vertexShader() const {
+  return GLSL(attribute vec4 position; uniform mat4 matrix;
+              void main() { gl_Position = matrix * position; });
+}
+
+const char* PositionShader::fragmentShader() const {
+  return GLSL(void main() { gl_FragColor = vec4(1.0); });
+}
+
+std::vector<std::string> PositionShader::attribute() const {
+  return {"position"};
+}
+
+void PositionShader::updateState(const Material*,
+                                 const RenderState& state) {
+  program()->setUniformValue(m_matrix, state.matrix());
+}
 }  // namespace SceneGraph
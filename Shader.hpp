@@ -1,40 +1,32 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
 #include <QOpenGLShaderProgram>
 #include <memory>
+#include "ResourceRegistry.hpp"
 #define GLSL(shader) #shader
 
 namespace SceneGraph {
 
-namespace Private {
-
-template <class T>
-class SingletonImpl {
- private:
-  std::unique_ptr<T> m_data;
-
-  SingletonImpl() : m_data(std::make_unique<T>()) {}
-
- public:
-  static SingletonImpl* instance() {
-    static SingletonImpl data;
-    return &data;
-  }
-
-  T* data() const { return m_data.get(); }
-};
-}
-
 class Material;
 class RenderState;
+class ShaderCache;
 
 const int MAX_ATTRIBUTE_COUNT = 8;
 
 class Shader {
  private:
   bool m_initialized;
+  bool m_linking;
+  bool m_failed;
   QOpenGLShaderProgram m_program;
+  std::unique_ptr<QOpenGLShader> m_vertex;
+  std::unique_ptr<QOpenGLShader> m_fragment;
   int m_attributeLocation[MAX_ATTRIBUTE_COUNT];
+  ShaderCache* m_cache;
+  QByteArray m_cacheKey;
+  bool m_cached;
 
  public:
   Shader();
@@ -43,6 +35,13 @@ class Shader {
   inline QOpenGLShaderProgram* program() { return &m_program; }
   inline bool bind() { return program()->bind(); }
   inline bool initialized() const { return m_initialized; }
+  inline bool linking() const { return m_linking; }
+  inline bool failed() const { return m_failed; }
+
+  // Starts linking the program, from a cached binary when there is one. The
+  // link completes in initialize(), which compiles here first if needed.
+  void compile(ShaderCache* cache = nullptr);
+  bool linkCompleted();
 
   virtual void initialize();
 
@@ -54,10 +53,43 @@ class Shader {
   virtual std::vector<std::string> attribute() const = 0;
   const int* attributeLocation() const { return m_attributeLocation; }
 
+  // Functions of the current context. Shaders are shared by the contexts of
+  // a share group, so they don't keep the ones of the context they were
+  // initialized in.
+  static inline QOpenGLFunctions* functions() {
+    return QOpenGLContext::currentContext()->functions();
+  }
+
+  // Instance shared by the current context's share group.
   template <class T>
   static T* get() {
-    return Private::SingletonImpl<T>::instance()->data();
+    return ResourceRegistry::current()->shader<T>();
   }
+
+  static bool parallelCompileSupported();
+};
+
+// Draws positions transformed by the state's matrix in white, for passes
+// which only write depth or stencil, or count samples.
+class PositionShader : public Shader {
+ private:
+  int m_matrix;
+
+ protected:
+  void initialize() override;
+
+  inline void activate() override {}
+  inline void deactivate() override {}
+
+  const char* vertexShader() const override;
+  const char* fragmentShader() const override;
+
+  std::vector<std::string> attribute() const override;
+
+ public:
+  PositionShader();
+
+  void updateState(const Material*, const RenderState&) override;
 };
 }  // namespace SceneGraph
 
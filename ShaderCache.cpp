@@ -0,0 +1,113 @@
+#include "ShaderCache.hpp"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QOpenGLContext>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+namespace SceneGraph {
+
+ShaderCache::ShaderCache(const std::string& driver)
+    : m_driver(driver), m_supported() {
+  initializeOpenGLFunctions();
+
+  QOpenGLContext* context = QOpenGLContext::currentContext();
+  QSurfaceFormat format = context->format();
+  int version = format.majorVersion() * 10 + format.minorVersion();
+  if ((context->isOpenGLES() && version >= 30) ||
+      (!context->isOpenGLES() &&
+       (version >= 41 || context->hasExtension("GL_ARB_get_program_binary")))) {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    m_supported = formats > 0;
+  }
+
+  m_driver += reinterpret_cast<const char*>(glGetString(GL_VENDOR));
+  m_driver += reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+
+  m_directory =
+      QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+      "/shaders";
+  if (m_supported && !QDir().mkpath(m_directory)) m_supported = false;
+}
+
+QString ShaderCache::path(const QByteArray& key) const {
+  return m_directory + "/" + QString::fromLatin1(key) + ".bin";
+}
+
+QByteArray ShaderCache::key(const char* vertexShader,
+                            const char* fragmentShader) const {
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(m_driver.c_str(), m_driver.size() + 1);
+  hash.addData(vertexShader, strlen(vertexShader) + 1);
+  hash.addData(fragmentShader, strlen(fragmentShader) + 1);
+  return hash.result().toHex();
+}
+
+void ShaderCache::prepare(GLuint program) {
+  if (m_supported)
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+bool ShaderCache::load(GLuint program, const QByteArray& key) {
+  if (!m_supported) return false;
+
+  QFile file(path(key));
+  if (!file.open(QIODevice::ReadOnly)) return false;
+
+  QByteArray data = file.readAll();
+  GLenum format;
+  if (data.size() <= int(sizeof(format))) return false;
+  memcpy(&format, data.constData(), sizeof(format));
+
+  glProgramBinary(program, format, data.constData() + sizeof(format),
+                  data.size() - sizeof(format));
+
+  GLint linked = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    // Binaries are rejected after driver updates which keep the version
+    // string, fall back to compiling from source.
+    remove(key);
+    return false;
+  }
+
+  return true;
+}
+
+void ShaderCache::store(GLuint program, const QByteArray& key) {
+  if (!m_supported) return;
+
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) return;
+
+  GLenum format;
+  QByteArray data(sizeof(format) + length, 0);
+  glGetProgramBinary(program, length, nullptr, &format,
+                     data.data() + sizeof(format));
+  memcpy(data.data(), &format, sizeof(format));
+
+  QSaveFile file(path(key));
+  if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() ||
+      !file.commit())
+    qDebug() << "[WARNING] Failed to store shader binary.";
+}
+
+void ShaderCache::remove(const QByteArray& key) { QFile::remove(path(key)); }
+}  // namespace SceneGraph
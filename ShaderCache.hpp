@@ -0,0 +1,34 @@
+#ifndef SHADERCACHE_HPP
+#define SHADERCACHE_HPP
+#include <QByteArray>
+#include <QOpenGLExtraFunctions>
+#include <QString>
+#include <string>
+
+namespace SceneGraph {
+
+// On-disk cache of linked program binaries, keyed by the shader sources and
+// the driver which produced them.
+class ShaderCache : protected QOpenGLExtraFunctions {
+ private:
+  std::string m_driver;
+  QString m_directory;
+  bool m_supported;
+
+  QString path(const QByteArray& key) const;
+
+ public:
+  ShaderCache(const std::string& driver);
+
+  inline bool supported() const { return m_supported; }
+
+  QByteArray key(const char* vertexShader, const char* fragmentShader) const;
+
+  void prepare(GLuint program);
+  bool load(GLuint program, const QByteArray& key);
+  void store(GLuint program, const QByteArray& key);
+  void remove(const QByteArray& key);
+};
+}  // namespace SceneGraph
+
+#endif  // SHADERCACHE_HPP
@@ -1,6 +1,6 @@
 #include "ShaderSource.hpp"
-#include <QTime>
 #include <cassert>
+#include "RenderTargetPool.hpp"
 #include "Renderer.hpp"
 #include "Window.hpp"
 
@@ -11,6 +11,8 @@ ShaderSource::ShaderSource(Item* parent)
       m_sourceItem(this),
       m_sourceRect(-1, -1, 2, 2),
       m_background(Qt::white),
+      m_maximumUpdateRate(),
+      m_transient(),
       m_node() {
   m_sourceItem.setVisible(false);
 
@@ -34,6 +36,16 @@ void ShaderSource::setBackground(QColor color) {
   update();
 }
 
+void ShaderSource::setMaximumUpdateRate(qreal rate) {
+  m_maximumUpdateRate = rate;
+  update();
+}
+
+void ShaderSource::setTransient(bool transient) {
+  m_transient = transient;
+  update();
+}
+
 void ShaderSource::invalidate() {
   Item::invalidate();
   m_node = nullptr;
@@ -49,21 +61,105 @@ std::unique_ptr<Node> ShaderSource::synchronize(std::unique_ptr<Node> node) {
 }
 
 ShaderSource::ShaderNode::ShaderNode(QSize size, Node* parent)
-    : Node(parent), m_fbo(), m_capturedNode(), m_size(size), m_lastUpdate(-1) {
+    : Node(parent), m_fbo(), m_capturedNode(), m_size(size),
+      m_lastUpdate(-1),
+      m_capturedSerial(),
+      m_dirty(true),
+      m_maximumUpdateRate(),
+      m_transient(),
+      m_prepared() {
   initializeOpenGLFunctions();
+  setFlag(UsePreprocess);
+}
+
+ShaderSource::ShaderNode::~ShaderNode() {
+  if (auto pool = m_pool.lock()) pool->release(m_fbo);
+}
+
+QMatrix4x4 ShaderSource::ShaderNode::projection() const {
+  QMatrix4x4 matrix;
+  matrix.ortho(m_viewport.left(), m_viewport.right(), m_viewport.top(),
+               m_viewport.bottom(), -1, 1);
+  return matrix;
 }
 
-ShaderSource::ShaderNode::~ShaderNode() {}
+QSize ShaderSource::ShaderNode::textureSize() const {
+  qreal scale = renderer()->resolutionScale();
+  return (QSizeF(m_size) * scale).toSize().expandedTo(QSize(1, 1));
+}
+
+bool ShaderSource::ShaderNode::outdated() const {
+  return !m_fbo || m_fbo->size() != RenderTargetPool::bucket(textureSize()) ||
+         m_dirty ||
+         (m_capturedNode && m_capturedNode->changeSerial() != m_capturedSerial);
+}
+
+bool ShaderSource::ShaderNode::inputsUpdated() const {
+  for (Node* node : m_passes) {
+    ShaderNode* input = dynamic_cast<ShaderNode*>(node);
+    if (input && input->m_lastUpdate == renderer()->frame()) return true;
+  }
+  return false;
+}
+
+void ShaderSource::ShaderNode::prepare(std::vector<Node*>& inputs) {
+  if (!m_capturedNode) return;
+
+  // The shown ShaderSources are only searched for again when the captured
+  // subtree changed, otherwise the last ones are still there.
+  if (outdated()) {
+    m_passes.clear();
+    m_list = renderer()->gather(m_capturedNode, RenderState(projection()),
+                                &m_passes);
+    m_prepared = renderer()->frame();
+  }
+  inputs.insert(inputs.end(), m_passes.begin(), m_passes.end());
+}
+
+void ShaderSource::ShaderNode::preprocess() { updateTexture(); }
+
+void ShaderSource::ShaderNode::releaseOutput() {
+  if (!m_transient) return;
+
+  if (auto pool = m_pool.lock()) pool->release(m_fbo);
+  m_fbo = nullptr;
+}
+
+bool ShaderSource::ShaderNode::transientOutput() const { return m_transient; }
 
 void ShaderSource::ShaderNode::updateTexture() {
   assert(renderer());
 
   if (m_lastUpdate == renderer()->frame()) return;
-  m_lastUpdate = renderer()->frame();
 
   assert(m_size.isValid());
-  if (!m_fbo || m_fbo->size() != m_size)
-    m_fbo = std::make_unique<QOpenGLFramebufferObject>(m_size);
+  std::shared_ptr<RenderTargetPool> pool = renderer()->renderTargetPool();
+  std::shared_ptr<RenderTargetPool> previous = m_pool.lock();
+  if (previous != pool) {
+    if (previous) previous->release(m_fbo);
+    m_pool = pool;
+    m_fbo = nullptr;
+  }
+
+  bool resized =
+      !m_fbo || m_fbo->size() != RenderTargetPool::bucket(textureSize());
+  if (!outdated() && !inputsUpdated()) return;
+
+  if (!resized && m_maximumUpdateRate > 0 && m_updateTimer.isValid() &&
+      m_updateTimer.elapsed() < 1000 / m_maximumUpdateRate) {
+    renderer()->requestFrame();
+    return;
+  }
+
+  m_lastUpdate = renderer()->frame();
+  m_capturedSerial = m_capturedNode ? m_capturedNode->changeSerial() : 0;
+  m_dirty = false;
+  m_updateTimer.start();
+
+  if (resized) {
+    pool->release(m_fbo);
+    m_fbo = pool->acquire(textureSize());
+  }
 
   m_fbo->bind();
 
@@ -76,21 +172,33 @@ void ShaderSource::ShaderNode::updateTexture() {
                  m_background.blueF(), m_background.alphaF());
     glClear(GL_COLOR_BUFFER_BIT);
 
-    QMatrix4x4 matrix;
-    matrix.ortho(m_viewport.left(), m_viewport.right(), m_viewport.top(),
-                 m_viewport.bottom(), -1, 1);
-    renderer()->render(m_capturedNode, RenderState(matrix));
+    if (m_prepared != renderer()->frame()) {
+      m_passes.clear();
+      m_list = renderer()->gather(m_capturedNode, RenderState(projection()),
+                                  &m_passes);
+    }
+    renderer()->submit(m_list);
+    m_list.clear();
+    m_prepared = 0;
 
     glViewport(view[0], view[1], view[2], view[3]);
   }
 
   m_fbo->release();
+  renderer()->addDamage(this);
 }
 
 void ShaderSource::ShaderNode::update(ShaderSource* i) {
-  m_capturedNode = i->m_sourceItem.m_itemNode.get();
+  TransformNode* captured = i->m_sourceItem.m_itemNode.get();
+  if (captured != m_capturedNode || i->m_background != m_background ||
+      i->m_sourceRect != m_viewport)
+    m_dirty = true;
+
+  m_capturedNode = captured;
   m_background = i->m_background;
   m_viewport = i->m_sourceRect;
   m_size = i->m_textureSize;
+  m_maximumUpdateRate = i->m_maximumUpdateRate;
+  m_transient = i->m_transient;
 }
 }  // namespace SceneGraph
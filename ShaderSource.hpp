@@ -2,35 +2,64 @@
 #define SHADERSOURCE_HPP
 
 #include <QColor>
+#include <QElapsedTimer>
 #include <QOpenGLFramebufferObject>
 #include <QOpenGLFunctions>
 #include <memory>
 #include "Item.hpp"
 #include "Node.hpp"
+#include "Renderer.hpp"
 
 namespace SceneGraph {
 
+class RenderTargetPool;
+
 class ShaderSource : public SceneGraph::Item {
  public:
   class ShaderNode : public Node, public QOpenGLFunctions {
    private:
     friend class ShaderSource;
 
-    std::unique_ptr<QOpenGLFramebufferObject> m_fbo;
+    std::weak_ptr<RenderTargetPool> m_pool;
+    QOpenGLFramebufferObject* m_fbo;
     TransformNode* m_capturedNode;
     QColor m_background;
     QSize m_size;
     QRectF m_viewport;
     uint m_lastUpdate;
+    uint m_capturedSerial;
+    bool m_dirty;
+    qreal m_maximumUpdateRate;
+    QElapsedTimer m_updateTimer;
+    bool m_transient;
+    Renderer::DrawList m_list;
+    uint m_prepared;
+    std::vector<Node*> m_passes;
 
     void update(ShaderSource* i);
+    QMatrix4x4 projection() const;
+    QSize textureSize() const;
+    bool outdated() const;
+    bool inputsUpdated() const;
+
+   protected:
+    void prepare(std::vector<Node*>& inputs) override;
+    void preprocess() override;
+    void releaseOutput() override;
+    bool transientOutput() const override;
 
    public:
     ShaderNode(QSize size, Node* = nullptr);
     ~ShaderNode();
 
+    // Renders the captured subtree if it or a ShaderSource it shows changed
+    // since the last update, at most at the maximum update rate.
     void updateTexture();
-    inline QOpenGLFramebufferObject* texture() { return m_fbo.get(); }
+    // The texture may be larger than the requested size; its whole area
+    // holds the source rect.
+    inline QOpenGLFramebufferObject* texture() {
+      return m_pool.expired() ? nullptr : m_fbo;
+    }
   };
 
  private:
@@ -38,6 +67,8 @@ class ShaderSource : public SceneGraph::Item {
   QRectF m_sourceRect;
   QSize m_textureSize;
   QColor m_background;
+  qreal m_maximumUpdateRate;
+  bool m_transient;
   ShaderNode* m_node;
 
  protected:
@@ -58,6 +89,18 @@ class ShaderSource : public SceneGraph::Item {
   inline QColor background() const { return m_background; }
   void setBackground(QColor);
 
+  // Updates per second of the texture, 0 for no limit. Useful for expensive
+  // live previews.
+  inline qreal maximumUpdateRate() const { return m_maximumUpdateRate; }
+  void setMaximumUpdateRate(qreal);
+
+  // A transient texture is only valid while the frame using it is drawn. Its
+  // memory goes back to the pool after the last reader, and it is rendered
+  // again in every frame which uses it, i.e. draws a material listing the
+  // shaderNode() in Material::inputs().
+  inline bool transient() const { return m_transient; }
+  void setTransient(bool);
+
   inline ShaderNode* shaderNode() const { return m_node; }
 
   void invalidate();
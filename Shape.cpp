@@ -0,0 +1,145 @@
+#include "Shape.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include "VertexFormat.hpp"
+
+namespace SceneGraph {
+
+namespace {
+
+void putColor(GLubyte* v, QColor c) {
+  uint32_t color = VertexFormat::packColor(c);
+  memcpy(v, &color, sizeof(color));
+}
+}  // namespace
+
+ShapeGeometry::ShapeGeometry()
+    : TypedGeometry(0, 0, GL_UNSIGNED_SHORT),
+      m_padding(1) {
+  setDrawingMode(GL_TRIANGLES);
+}
+
+void ShapeGeometry::setShapes(const std::vector<Shape>& shapes) {
+  assert(shapes.size() <= MAX_SHAPE_COUNT);
+  allocate(4 * shapes.size(), 6 * shapes.size());
+
+  ShapeVertex* v = vertices();
+  GLushort* index = indexData<GLushort>();
+  for (size_t i = 0; i < shapes.size(); i++) {
+    const Shape& s = shapes[i];
+    QPointF center = s.rect.center();
+    float halfWidth = float(s.rect.width() / 2);
+    float halfHeight = float(s.rect.height() / 2);
+    float x = halfWidth + m_padding, y = halfHeight + m_padding;
+
+    // Corners carry their offset from the center, the fragment shader
+    // measures the distance to the edge from it.
+    for (int corner = 0; corner < 4; corner++, v++) {
+      float lx = corner & 1 ? x : -x, ly = corner & 2 ? y : -y;
+      v->position[0] = float(center.x()) + lx;
+      v->position[1] = float(center.y()) + ly;
+      v->local[0] = lx;
+      v->local[1] = ly;
+      v->params[0] = halfWidth;
+      v->params[1] = halfHeight;
+      v->params[2] = s.radius;
+      v->params[3] = s.borderWidth;
+      putColor(v->color, s.color);
+      putColor(v->borderColor, s.borderWidth > 0 ? s.borderColor : s.color);
+    }
+
+    GLushort base = GLushort(4 * i);
+    const GLushort quad[] = {0, 1, 2, 2, 1, 3};
+    for (GLushort q : quad) *index++ = base + q;
+  }
+
+  updateVertexData();
+}
+
+ShapeMaterial::ShapeMaterial()
+    : m_shadowColor(Qt::transparent), m_shadowSoftness() {}
+
+Shader* ShapeMaterial::shader() const { return Shader::get<ShapeShader>(); }
+
+void ShapeMaterial::ShapeShader::initialize() {
+  Shader::initialize();
+
+  m_matrix = program()->uniformLocation("matrix");
+  m_pixelSize = program()->uniformLocation("pixelSize");
+  m_shadowColor = program()->uniformLocation("shadowColor");
+  m_shadowOffset = program()->uniformLocation("shadowOffset");
+  m_shadowSoftness = program()->uniformLocation("shadowSoftness");
+}
+
+const char* ShapeMaterial::ShapeShader::vertexShader() const {
+  return GLSL(
+      attribute vec4 position; attribute vec2 local; attribute vec4 params;
+      attribute vec4 color; attribute vec4 borderColor; uniform mat4 matrix;
+      varying vec2 flocal; varying vec4 fparams; varying vec4 fcolor;
+      varying vec4 fborderColor;
+
+      void main() {
+        flocal = local;
+        fparams = params;
+        fcolor = color;
+        fborderColor = borderColor;
+        gl_Position = matrix * position;
+      });
+}
+
+const char* ShapeMaterial::ShapeShader::fragmentShader() const {
+  return GLSL(
+      uniform float pixelSize; uniform vec4 shadowColor;
+      uniform vec2 shadowOffset; uniform float shadowSoftness;
+      varying vec2 flocal; varying vec4 fparams; varying vec4 fcolor;
+      varying vec4 fborderColor;
+
+      float boxDistance(vec2 p, vec2 size, float radius) {
+        vec2 q = abs(p) - size + radius;
+        return min(max(q.x, q.y), 0.0) + length(max(q, 0.0)) - radius;
+      }
+
+      void main() {
+        vec2 size = fparams.xy;
+        float radius = min(fparams.z, min(size.x, size.y));
+        float d = boxDistance(flocal, size, radius);
+
+        float fill = clamp(0.5 - d / pixelSize, 0.0, 1.0);
+        float inner = clamp(0.5 - (d + fparams.w) / pixelSize, 0.0, 1.0);
+        vec4 color = mix(fborderColor, fcolor, inner);
+        color.a *= fill;
+
+        float s = boxDistance(flocal - shadowOffset, size, radius);
+        float shadow = shadowColor.a *
+                       clamp(0.5 - s / max(shadowSoftness, pixelSize), 0.0,
+                             1.0) *
+                       (1.0 - color.a);
+
+        float alpha = color.a + shadow;
+        vec3 rgb = color.rgb * color.a + shadowColor.rgb * shadow;
+        gl_FragColor = vec4(rgb / max(alpha, 0.0001), alpha);
+      });
+}
+
+std::vector<std::string> ShapeMaterial::ShapeShader::attribute() const {
+  return {"position", "local", "params", "color", "borderColor"};
+}
+
+void ShapeMaterial::ShapeShader::updateState(const Material* m,
+                                             const RenderState& state) {
+  const ShapeMaterial* material = static_cast<const ShapeMaterial*>(m);
+
+  // Size of a pixel in the shapes' units, for antialiasing.
+  GLint view[4];
+  functions()->glGetIntegerv(GL_VIEWPORT, view);
+  QVector4D axis = state.matrix().column(0);
+  float scale = std::hypot(axis.x() * view[2], axis.y() * view[3]) / 2;
+
+  program()->setUniformValue(m_matrix, state.matrix());
+  program()->setUniformValue(m_pixelSize, scale > 0 ? 1 / scale : 1.0f);
+  program()->setUniformValue(m_shadowColor, material->shadowColor());
+  program()->setUniformValue(m_shadowOffset, material->shadowOffset());
+  program()->setUniformValue(m_shadowSoftness, material->shadowSoftness());
+}
+}  // namespace SceneGraph
@@ -0,0 +1,110 @@
+#ifndef SHAPE_HPP
+#define SHAPE_HPP
+#include <QColor>
+#include <QRectF>
+#include <QVector2D>
+#include <vector>
+#include "Material.hpp"
+#include "TypedGeometry.hpp"
+
+namespace SceneGraph {
+
+// Quad corner, with the offset from the shape's center, its half size,
+// radius and border width, and both colors.
+struct ShapeVertex {
+  GLfloat position[2];
+  GLfloat local[2];
+  GLfloat params[4];
+  GLubyte color[4];
+  GLubyte borderColor[4];
+
+  static std::vector<std::string> attribute() {
+    return {"position", "local", "params", "color", "borderColor"};
+  }
+};
+
+template <>
+struct VertexLayoutOf<ShapeVertex>
+    : VertexLayout<Field<VERTEX_MEMBER(ShapeVertex, position)>,
+                   Field<VERTEX_MEMBER(ShapeVertex, local)>,
+                   Field<VERTEX_MEMBER(ShapeVertex, params)>,
+                   Field<VERTEX_MEMBER(ShapeVertex, color), true>,
+                   Field<VERTEX_MEMBER(ShapeVertex, borderColor), true>> {};
+
+// Batch of rectangles, rounded rectangles and circles drawn as one quad each.
+// Edges are evaluated from a signed distance in ShapeMaterial's fragment
+// shader, so a batch is a single draw whatever its size.
+class ShapeGeometry : public TypedGeometry<ShapeVertex> {
+ public:
+  struct Shape {
+    QRectF rect;
+    // Corner radius, half of the shorter side makes an ellipse into a circle
+    // for square rects.
+    float radius;
+    float borderWidth;
+    QColor color;
+    QColor borderColor;
+  };
+
+  // Indices are 16 bit.
+  static const uint MAX_SHAPE_COUNT = 16383;
+
+ private:
+  float m_padding;
+
+ public:
+  ShapeGeometry();
+
+  // Extra space around each shape, which has to cover the shadow of the
+  // material.
+  inline float padding() const { return m_padding; }
+  inline void setPadding(float p) { m_padding = p; }
+
+  void setShapes(const std::vector<Shape>&);
+};
+
+class ShapeMaterial : public Material {
+ private:
+  class ShapeShader : public Shader {
+   private:
+    int m_matrix;
+    int m_pixelSize;
+    int m_shadowColor;
+    int m_shadowOffset;
+    int m_shadowSoftness;
+
+   protected:
+    void initialize() override;
+
+    inline void activate() override {}
+    inline void deactivate() override {}
+
+    const char* vertexShader() const override;
+    const char* fragmentShader() const override;
+
+    std::vector<std::string> attribute() const override;
+
+    void updateState(const Material*, const RenderState&) override;
+  };
+
+  QColor m_shadowColor;
+  QVector2D m_shadowOffset;
+  float m_shadowSoftness;
+
+ public:
+  ShapeMaterial();
+
+  Shader* shader() const override;
+
+  inline QColor shadowColor() const { return m_shadowColor; }
+  inline void setShadowColor(QColor c) { m_shadowColor = c; }
+
+  inline QVector2D shadowOffset() const { return m_shadowOffset; }
+  inline void setShadowOffset(QVector2D o) { m_shadowOffset = o; }
+
+  inline float shadowSoftness() const { return m_shadowSoftness; }
+  inline void setShadowSoftness(float s) { m_shadowSoftness = s; }
+};
+}  // namespace SceneGraph
+
+#endif  // SHAPE_HPP
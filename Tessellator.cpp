@@ -0,0 +1,357 @@
+#include "Tessellator.hpp"
+#include <QMutex>
+#include <QtConcurrent>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <list>
+#include <unordered_map>
+#include "Geometry.hpp"
+
+namespace SceneGraph {
+
+namespace {
+
+using Contour = std::vector<QPointF>;
+
+const uint MAX_CURVE_SEGMENTS = 256;
+
+double cross(QPointF o, QPointF a, QPointF b) {
+  return (a.x() - o.x()) * (b.y() - o.y()) - (a.y() - o.y()) * (b.x() - o.x());
+}
+
+double area(const Contour& c) {
+  double result = 0;
+  for (size_t i = 0, j = c.size() - 1; i < c.size(); j = i++)
+    result += c[j].x() * c[i].y() - c[i].x() * c[j].y();
+  return result / 2;
+}
+
+bool contains(const Contour& c, QPointF p) {
+  bool inside = false;
+  for (size_t i = 0, j = c.size() - 1; i < c.size(); j = i++)
+    if ((c[i].y() > p.y()) != (c[j].y() > p.y()) &&
+        p.x() < (c[j].x() - c[i].x()) * (p.y() - c[i].y()) /
+                        (c[j].y() - c[i].y()) +
+                    c[i].x())
+      inside = !inside;
+  return inside;
+}
+
+bool inTriangle(QPointF a, QPointF b, QPointF c, QPointF p) {
+  return cross(a, b, p) >= 0 && cross(b, c, p) >= 0 && cross(c, a, p) >= 0;
+}
+
+std::vector<Contour> flatten(const QPainterPath& path, float tolerance,
+                             std::vector<bool>* closed = nullptr) {
+  std::vector<Contour> result;
+  for (int i = 0; i < path.elementCount(); i++) {
+    QPainterPath::Element e = path.elementAt(i);
+    QPointF p(e.x, e.y);
+    if (e.isMoveTo() || result.empty()) {
+      result.push_back({p});
+    } else if (e.isLineTo()) {
+      result.back().push_back(p);
+    } else if (e.isCurveTo()) {
+      QPainterPath::Element c2 = path.elementAt(i + 1);
+      QPainterPath::Element c3 = path.elementAt(i + 2);
+      i += 2;
+      QPointF p0 = result.back().back(), p1 = p, p2(c2.x, c2.y),
+              p3(c3.x, c3.y);
+
+      // Deviation of the chords bounded by the second differences.
+      QPointF d1 = p0 - 2 * p1 + p2, d2 = p1 - 2 * p2 + p3;
+      double dd = std::max(std::hypot(d1.x(), d1.y()),
+                           std::hypot(d2.x(), d2.y()));
+      uint n = uint(std::ceil(std::sqrt(0.75 * dd / tolerance)));
+      n = std::min(std::max(n, 1u), MAX_CURVE_SEGMENTS);
+      for (uint k = 1; k <= n; k++) {
+        double t = double(k) / n, u = 1 - t;
+        result.back().push_back(u * u * u * p0 + 3 * u * u * t * p1 +
+                                3 * u * t * t * p2 + t * t * t * p3);
+      }
+    }
+  }
+
+  std::vector<Contour> contours;
+  for (Contour& c : result) {
+    bool isClosed = c.size() > 2 && c.front() == c.back();
+    if (isClosed) c.pop_back();
+    if (c.size() < 2) continue;
+    if (closed) closed->push_back(isClosed);
+    contours.push_back(std::move(c));
+  }
+  return contours;
+}
+
+// Joins a hole to the outline it lies in through a pair of coincident edges
+// from its rightmost vertex to a vertex of the outline it can see.
+void bridge(std::vector<uint>& outline, const std::vector<uint>& hole,
+            const std::vector<QPointF>& point) {
+  size_t m = 0;
+  for (size_t i = 1; i < hole.size(); i++)
+    if (point[hole[i]].x() > point[hole[m]].x()) m = i;
+  QPointF mp = point[hole[m]];
+
+  size_t best = 0;
+  double nearest = INFINITY;
+  for (size_t i = 0; i < outline.size(); i++) {
+    QPointF a = point[outline[i]], b = point[outline[(i + 1) % outline.size()]];
+    if ((a.y() > mp.y()) == (b.y() > mp.y())) continue;
+    double x = a.x() + (mp.y() - a.y()) * (b.x() - a.x()) / (b.y() - a.y());
+    if (x < mp.x() || x >= nearest) continue;
+    nearest = x;
+    best = a.x() > b.x() ? i : (i + 1) % outline.size();
+  }
+  if (std::isinf(nearest)) return;
+
+  // Vertices inside the triangle between the hole, the hit and the chosen
+  // vertex would block the bridge, the one closest in angle is visible.
+  QPointF hit(nearest, mp.y()), bp = point[outline[best]];
+  double bestAngle = INFINITY;
+  for (size_t i = 0; i < outline.size(); i++) {
+    QPointF p = point[outline[i]];
+    if (i == best || p.x() < mp.x()) continue;
+    bool inside = inTriangle(mp, hit, bp, p) || inTriangle(mp, bp, hit, p);
+    if (!inside) continue;
+    double angle = std::abs(std::atan2(p.y() - mp.y(), p.x() - mp.x()));
+    if (angle < bestAngle) {
+      bestAngle = angle;
+      best = i;
+    }
+  }
+
+  std::vector<uint> merged(outline.begin(), outline.begin() + best + 1);
+  for (size_t i = 0; i <= hole.size(); i++)
+    merged.push_back(hole[(m + i) % hole.size()]);
+  merged.push_back(outline[best]);
+  merged.insert(merged.end(), outline.begin() + best + 1, outline.end());
+  outline = std::move(merged);
+}
+
+// Ear clipping of a counter clockwise polygon.
+void clip(std::vector<uint> polygon, const std::vector<QPointF>& point,
+          std::vector<uint>& index) {
+  while (polygon.size() > 3) {
+    size_t n = polygon.size(), ear = n;
+    for (size_t i = 0; i < n && ear == n; i++) {
+      uint a = polygon[(i + n - 1) % n], b = polygon[i], c = polygon[(i + 1) % n];
+      if (cross(point[a], point[b], point[c]) <= 0) continue;
+
+      bool empty = true;
+      for (size_t j = 0; j < n && empty; j++) {
+        uint p = polygon[j];
+        if (point[p] == point[a] || point[p] == point[b] ||
+            point[p] == point[c])
+          continue;
+        empty = !inTriangle(point[a], point[b], point[c], point[p]);
+      }
+      if (empty) ear = i;
+    }
+
+    // Degenerate leftovers are clipped anyway to make progress.
+    if (ear == n) ear = 0;
+    index.push_back(polygon[(ear + n - 1) % n]);
+    index.push_back(polygon[ear]);
+    index.push_back(polygon[(ear + 1) % n]);
+    polygon.erase(polygon.begin() + ear);
+  }
+  if (polygon.size() == 3)
+    index.insert(index.end(), polygon.begin(), polygon.end());
+}
+
+std::shared_ptr<const Tessellator::Result> fillPath(QPainterPath path,
+                                                    float tolerance) {
+  auto result = std::make_shared<Tessellator::Result>();
+  std::vector<Contour> contour = flatten(path, tolerance);
+
+  std::vector<QPointF> point;
+  std::vector<std::vector<uint>> polygon(contour.size());
+  std::vector<int> depth(contour.size()), parent(contour.size(), -1);
+  for (size_t i = 0; i < contour.size(); i++) {
+    for (size_t j = 0; j < contour.size(); j++) {
+      if (i == j || contour[j].size() < 3 ||
+          !contains(contour[j], contour[i][0]))
+        continue;
+      depth[i]++;
+      if (parent[i] == -1 ||
+          std::abs(area(contour[j])) < std::abs(area(contour[parent[i]])))
+        parent[i] = int(j);
+    }
+
+    // Outlines counter clockwise, holes clockwise.
+    bool flip = (area(contour[i]) < 0) == (depth[i] % 2 == 0);
+    for (size_t k = 0; k < contour[i].size(); k++) {
+      size_t v = flip ? contour[i].size() - 1 - k : k;
+      polygon[i].push_back(point.size());
+      point.push_back(contour[i][v]);
+    }
+  }
+
+  for (size_t i = 0; i < contour.size(); i++) {
+    if (depth[i] % 2 != 0 || contour[i].size() < 3) continue;
+
+    std::vector<size_t> hole;
+    for (size_t j = 0; j < contour.size(); j++)
+      if (parent[j] == int(i) && depth[j] % 2 != 0 && contour[j].size() >= 3)
+        hole.push_back(j);
+    std::sort(hole.begin(), hole.end(), [&](size_t a, size_t b) {
+      auto right = [&](size_t c) {
+        return std::max_element(contour[c].begin(), contour[c].end(),
+                                [](QPointF p, QPointF q) {
+                                  return p.x() < q.x();
+                                })
+            ->x();
+      };
+      return right(a) > right(b);
+    });
+
+    std::vector<uint> outline = polygon[i];
+    for (size_t h : hole) bridge(outline, polygon[h], point);
+    clip(std::move(outline), point, result->index);
+  }
+
+  for (QPointF p : point) {
+    result->vertex.push_back(float(p.x()));
+    result->vertex.push_back(float(p.y()));
+  }
+  return result;
+}
+
+std::shared_ptr<const Tessellator::Result> strokePath(QPainterPath path,
+                                                      float width,
+                                                      float tolerance) {
+  auto result = std::make_shared<Tessellator::Result>();
+  std::vector<bool> closed;
+  std::vector<Contour> contour = flatten(path, tolerance, &closed);
+
+  auto vertex = [&](QPointF p) {
+    result->vertex.push_back(float(p.x()));
+    result->vertex.push_back(float(p.y()));
+    return uint(result->vertex.size() / 2 - 1);
+  };
+  auto normal = [&](QPointF a, QPointF b) {
+    QPointF d = b - a;
+    double length = std::hypot(d.x(), d.y());
+    if (length == 0) return QPointF();
+    return QPointF(-d.y(), d.x()) * (width / 2 / length);
+  };
+
+  for (size_t c = 0; c < contour.size(); c++) {
+    const Contour& line = contour[c];
+    size_t segments = closed[c] ? line.size() : line.size() - 1;
+    for (size_t i = 0; i < segments; i++) {
+      QPointF a = line[i], b = line[(i + 1) % line.size()];
+      QPointF n = normal(a, b);
+      uint v = vertex(a + n);
+      vertex(a - n);
+      vertex(b + n);
+      vertex(b - n);
+      for (uint q : {0u, 1u, 2u, 2u, 1u, 3u}) result->index.push_back(v + q);
+
+      // Bevel towards the next segment, on both sides since only one of
+      // them is outside.
+      if (i + 1 < segments || closed[c]) {
+        QPointF next = line[(i + 2) % line.size()];
+        QPointF m = normal(b, next);
+        uint center = vertex(b);
+        uint p0 = vertex(b + n), p1 = vertex(b + m);
+        uint q0 = vertex(b - n), q1 = vertex(b - m);
+        for (uint q : {center, p0, p1, center, q1, q0})
+          result->index.push_back(q);
+      }
+    }
+  }
+  return result;
+}
+
+class Cache {
+ private:
+  using Entry = std::pair<std::string, Tessellator::Future>;
+
+  const size_t m_capacity = 512;
+  QMutex m_mutex;
+  std::list<Entry> m_entry;
+  std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+
+ public:
+  template <class Function>
+  Tessellator::Future get(const std::string& key, Function f) {
+    QMutexLocker lock(&m_mutex);
+    auto it = m_index.find(key);
+    if (it != m_index.end()) {
+      m_entry.splice(m_entry.begin(), m_entry, it->second);
+      return it->second->second;
+    }
+
+    m_entry.emplace_front(key, QtConcurrent::run(f));
+    m_index[key] = m_entry.begin();
+    if (m_entry.size() > m_capacity) {
+      m_index.erase(m_entry.back().first);
+      m_entry.pop_back();
+    }
+    return m_entry.front().second;
+  }
+};
+
+Cache cache;
+
+std::string key(const QPainterPath& path, char mode, float width,
+                float tolerance) {
+  std::string result(1, mode);
+  auto append = [&](const void* data, size_t size) {
+    result.append(static_cast<const char*>(data), size);
+  };
+  append(&width, sizeof(width));
+  append(&tolerance, sizeof(tolerance));
+  for (int i = 0; i < path.elementCount(); i++) {
+    QPainterPath::Element e = path.elementAt(i);
+    int type = e.type;
+    append(&type, sizeof(type));
+    append(&e.x, sizeof(e.x));
+    append(&e.y, sizeof(e.y));
+  }
+  return result;
+}
+}  // namespace
+
+Tessellator::Future Tessellator::fill(const QPainterPath& path,
+                                      float tolerance) {
+  return cache.get(key(path, 'f', 0, tolerance),
+                   [path, tolerance] { return fillPath(path, tolerance); });
+}
+
+Tessellator::Future Tessellator::stroke(const QPainterPath& path, float width,
+                                        float tolerance) {
+  return cache.get(key(path, 's', width, tolerance), [path, width, tolerance] {
+    return strokePath(path, width, tolerance);
+  });
+}
+
+void Tessellator::write(const Result& result, Geometry* geometry) {
+  assert(geometry->attribute().size() > 0 &&
+         geometry->attribute()[0].primitiveType == GL_FLOAT &&
+         geometry->attribute()[0].tupleSize >= 2);
+
+  uint vertexCount = result.vertex.size() / 2;
+  geometry->allocate(vertexCount, result.index.size());
+  geometry->setDrawingMode(GL_TRIANGLES);
+
+  char* vertex = geometry->vertexData<char>();
+  for (uint i = 0; i < vertexCount; i++)
+    memcpy(vertex + i * geometry->vertexSize(), &result.vertex[2 * i],
+           2 * sizeof(float));
+
+  if (geometry->indexType() == GL_UNSIGNED_SHORT) {
+    assert(vertexCount <= 0xFFFF);
+    std::copy(result.index.begin(), result.index.end(),
+              geometry->indexData<GLushort>());
+  } else {
+    assert(geometry->indexType() == GL_UNSIGNED_INT);
+    std::copy(result.index.begin(), result.index.end(),
+              geometry->indexData<GLuint>());
+  }
+
+  geometry->updateVertexData();
+}
+}  // namespace SceneGraph
@@ -0,0 +1,40 @@
+#ifndef TESSELLATOR_HPP
+#define TESSELLATOR_HPP
+#include <QFuture>
+#include <QPainterPath>
+#include <memory>
+#include <vector>
+
+namespace SceneGraph {
+
+class Geometry;
+
+// Triangulates the fill or the stroke of a path on the global thread pool.
+// Curves are flattened to within the tolerance, and subpaths nested inside
+// one another alternate between filled areas and holes. Results are cached
+// by path, mode and tolerance, so asking again for an unchanged shape returns
+// the finished triangulation.
+class Tessellator {
+ public:
+  struct Result {
+    // Two floats per vertex.
+    std::vector<float> vertex;
+    std::vector<uint> index;
+  };
+
+  using Future = QFuture<std::shared_ptr<const Result>>;
+
+  static Future fill(const QPainterPath&, float tolerance = 0.25f);
+
+  // Segments are joined with bevels, subpaths ending where they start are
+  // closed.
+  static Future stroke(const QPainterPath&, float width,
+                       float tolerance = 0.25f);
+
+  // Writes the triangles into the first attribute of the geometry, which has
+  // to have at least two floats, and uploads them.
+  static void write(const Result&, Geometry*);
+};
+}  // namespace SceneGraph
+
+#endif  // TESSELLATOR_HPP
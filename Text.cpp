@@ -0,0 +1,273 @@
+#include "Text.hpp"
+#include <QGlyphRun>
+#include <QRawFont>
+#include <QTextLayout>
+#include <cmath>
+#include <list>
+#include <unordered_map>
+#include "GlyphAtlas.hpp"
+#include "ResourceRegistry.hpp"
+
+namespace SceneGraph {
+
+namespace {
+
+const uint VERTEX_SIZE = 4;
+const uint MAX_GLYPH_COUNT = 16383;
+
+struct Layout {
+  struct Run {
+    QRawFont font;
+    std::vector<quint32> index;
+    std::vector<QPointF> position;
+  };
+
+  std::vector<Run> run;
+  QRectF boundingRect;
+};
+
+// Recently shaped texts, shared by all text nodes.
+class LayoutCache {
+ private:
+  using Entry = std::pair<std::string, std::shared_ptr<const Layout>>;
+
+  const size_t m_capacity = 256;
+  QMutex m_mutex;
+  std::list<Entry> m_entry;
+  std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+
+  static std::shared_ptr<const Layout> layout(const QString& text,
+                                              const QFont& font, qreal width) {
+    auto result = std::make_shared<Layout>();
+
+    QTextLayout layout(text, font);
+    layout.setCacheEnabled(true);
+    QTextOption option;
+    option.setWrapMode(width > 0 ? QTextOption::WordWrap
+                                 : QTextOption::NoWrap);
+    layout.setTextOption(option);
+
+    layout.beginLayout();
+    qreal y = 0;
+    for (QTextLine line = layout.createLine(); line.isValid();
+         line = layout.createLine()) {
+      if (width > 0) line.setLineWidth(width);
+      line.setPosition(QPointF(0, y));
+      y += line.height();
+    }
+    layout.endLayout();
+
+    for (const QGlyphRun& glyphRun : layout.glyphRuns()) {
+      Layout::Run run;
+      run.font = glyphRun.rawFont();
+      auto index = glyphRun.glyphIndexes();
+      auto position = glyphRun.positions();
+      run.index.assign(index.begin(), index.end());
+      run.position.assign(position.begin(), position.end());
+      result->run.push_back(std::move(run));
+    }
+    result->boundingRect = layout.boundingRect();
+    return result;
+  }
+
+ public:
+  std::shared_ptr<const Layout> get(const QString& text, const QFont& font,
+                                    qreal width) {
+    std::string key = (text + QString(QChar(0)) + font.key() +
+                       QString(QChar(0)) + QString::number(width))
+                          .toStdString();
+
+    QMutexLocker lock(&m_mutex);
+    auto it = m_index.find(key);
+    if (it != m_index.end()) {
+      m_entry.splice(m_entry.begin(), m_entry, it->second);
+      return it->second->second;
+    }
+    lock.unlock();
+
+    std::shared_ptr<const Layout> result = layout(text, font, width);
+
+    lock.relock();
+    if (m_index.find(key) == m_index.end()) {
+      m_entry.emplace_front(key, result);
+      m_index[key] = m_entry.begin();
+      if (m_entry.size() > m_capacity) {
+        m_index.erase(m_entry.back().first);
+        m_entry.pop_back();
+      }
+    }
+    return result;
+  }
+};
+
+LayoutCache layoutCache;
+}  // namespace
+
+TextMaterial::TextMaterial() : m_texture(), m_color(Qt::black), m_scale(1) {}
+
+Shader* TextMaterial::shader() const { return Shader::get<TextShader>(); }
+
+void TextMaterial::TextShader::initialize() {
+  Shader::initialize();
+
+  m_matrix = program()->uniformLocation("matrix");
+  m_texture = program()->uniformLocation("texture");
+  m_color = program()->uniformLocation("color");
+  m_smoothing = program()->uniformLocation("smoothing");
+}
+
+const char* TextMaterial::TextShader::vertexShader() const {
+  return GLSL(attribute vec4 position; attribute vec2 tcoord;
+              uniform mat4 matrix; varying vec2 texcoord;
+
+              void main() {
+                texcoord = tcoord;
+                gl_Position = matrix * position;
+              });
+}
+
+const char* TextMaterial::TextShader::fragmentShader() const {
+  return GLSL(uniform sampler2D texture; uniform vec4 color;
+              uniform float smoothing; varying vec2 texcoord;
+
+              void main() {
+                float distance = texture2D(texture, texcoord).r;
+                float alpha = smoothstep(0.5 - smoothing, 0.5 + smoothing,
+                                         distance);
+                gl_FragColor = vec4(color.rgb, color.a * alpha);
+              });
+}
+
+std::vector<std::string> TextMaterial::TextShader::attribute() const {
+  return {"position", "tcoord"};
+}
+
+void TextMaterial::TextShader::updateState(const Material* m,
+                                           const RenderState& state) {
+  const TextMaterial* material = static_cast<const TextMaterial*>(m);
+
+  // The field falls by 1 / (2 * SPREAD) per atlas pixel, the edge is
+  // smoothed over about one pixel on screen.
+  GLint view[4];
+  functions()->glGetIntegerv(GL_VIEWPORT, view);
+  QVector4D axis = state.matrix().column(0);
+  float pixels = std::hypot(axis.x() * view[2], axis.y() * view[3]) / 2 *
+                 material->scale();
+  float smoothing = 0.5f / (2 * GlyphAtlas::SPREAD * std::max(pixels, 0.01f));
+
+  functions()->glActiveTexture(GL_TEXTURE0);
+  functions()->glBindTexture(GL_TEXTURE_2D, material->texture());
+  program()->setUniformValue(m_matrix, state.matrix());
+  program()->setUniformValue(m_texture, 0);
+  program()->setUniformValue(m_color, material->color());
+  program()->setUniformValue(m_smoothing, std::min(smoothing, 0.5f));
+}
+
+TextNode::Page::Page()
+    : geometry({{2, GL_FLOAT}, {2, GL_FLOAT}}, 0, VERTEX_SIZE * sizeof(float),
+               0, GL_UNSIGNED_SHORT) {
+  geometry.setDrawingMode(GL_TRIANGLES);
+  node.setGeometry(&geometry);
+  node.setMaterial(&material);
+}
+
+TextNode::TextNode(Node* parent)
+    : Node(parent), m_color(Qt::black), m_width(), m_dirty(true) {}
+
+void TextNode::setText(const QString& text) {
+  if (text == m_text) return;
+  m_text = text;
+  m_dirty = true;
+}
+
+void TextNode::setFont(const QFont& font) {
+  if (font == m_font) return;
+  m_font = font;
+  m_dirty = true;
+}
+
+void TextNode::setColor(QColor color) {
+  m_color = color;
+  for (const auto& page : m_page) page->material.setColor(color);
+  markChanged();
+}
+
+void TextNode::setWidth(qreal width) {
+  if (width == m_width) return;
+  m_width = width;
+  m_dirty = true;
+}
+
+void TextNode::update() {
+  if (!m_dirty) return;
+  m_dirty = false;
+
+  std::shared_ptr<const Layout> layout =
+      layoutCache.get(m_text, m_font, m_width);
+  m_boundingRect = layout->boundingRect;
+
+  // Glyph quads sorted by atlas page.
+  GlyphAtlas* atlas = ResourceRegistry::current()->glyphAtlas();
+  std::vector<std::vector<float>> vertex;
+  for (const Layout::Run& run : layout->run) {
+    float scale = float(run.font.pixelSize() / GlyphAtlas::GLYPH_SIZE);
+    for (size_t i = 0; i < run.index.size(); i++) {
+      GlyphAtlas::Glyph glyph = atlas->glyph(run.font, run.index[i]);
+      if (glyph.rect.isEmpty()) continue;
+
+      if (vertex.size() <= glyph.page) vertex.resize(glyph.page + 1);
+      std::vector<float>& v = vertex[glyph.page];
+      if (v.size() >= 4 * VERTEX_SIZE * MAX_GLYPH_COUNT) continue;
+
+      QPointF p = run.position[i];
+      for (int corner = 0; corner < 4; corner++) {
+        qreal x = corner & 1 ? glyph.rect.right() : glyph.rect.left();
+        qreal y = corner & 2 ? glyph.rect.bottom() : glyph.rect.top();
+        v.push_back(float(p.x() + x * scale));
+        v.push_back(float(p.y() + y * scale));
+        v.push_back(
+            float(corner & 1 ? glyph.texture.right() : glyph.texture.left()));
+        v.push_back(
+            float(corner & 2 ? glyph.texture.bottom() : glyph.texture.top()));
+      }
+    }
+  }
+
+  while (m_page.size() < vertex.size()) {
+    m_page.push_back(std::make_unique<Page>());
+    appendChild(&m_page.back()->node);
+  }
+
+  float scale = layout->run.empty() ? 1
+                                    : float(layout->run[0].font.pixelSize() /
+                                            GlyphAtlas::GLYPH_SIZE);
+  for (uint i = 0; i < m_page.size(); i++) {
+    Page& page = *m_page[i];
+    uint glyphs = i < vertex.size() ? vertex[i].size() / (4 * VERTEX_SIZE) : 0;
+    page.geometry.allocate(4 * glyphs, 6 * glyphs);
+    if (glyphs) {
+      std::copy(vertex[i].begin(), vertex[i].end(),
+                page.geometry.vertexData<float>());
+      GLushort* index = page.geometry.indexData<GLushort>();
+      for (uint g = 0; g < glyphs; g++) {
+        const GLushort quad[] = {0, 1, 2, 2, 1, 3};
+        for (GLushort q : quad) *index++ = GLushort(4 * g + q);
+      }
+    }
+    page.geometry.updateVertexData();
+
+    page.material.setTexture(atlas->texture(i));
+    page.material.setColor(m_color);
+    page.material.setScale(scale);
+
+    // Pages without glyphs of this text stay out of the tree.
+    if (glyphs && !page.node.parent())
+      appendChild(&page.node);
+    else if (!glyphs && page.node.parent())
+      removeChild(&page.node);
+  }
+
+  invalidateBounds();
+  markChanged();
+}
+}  // namespace SceneGraph
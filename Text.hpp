@@ -0,0 +1,105 @@
+#ifndef TEXT_HPP
+#define TEXT_HPP
+#include <QColor>
+#include <QFont>
+#include <QString>
+#include <memory>
+#include <vector>
+#include "Geometry.hpp"
+#include "Material.hpp"
+#include "Node.hpp"
+
+namespace SceneGraph {
+
+class TextMaterial : public Material {
+ private:
+  class TextShader : public Shader {
+   private:
+    int m_matrix;
+    int m_texture;
+    int m_color;
+    int m_smoothing;
+
+   protected:
+    void initialize() override;
+
+    inline void activate() override {}
+    inline void deactivate() override {}
+
+    const char* vertexShader() const override;
+    const char* fragmentShader() const override;
+
+    std::vector<std::string> attribute() const override;
+
+    void updateState(const Material*, const RenderState&) override;
+  };
+
+  GLuint m_texture;
+  QColor m_color;
+  float m_scale;
+
+ public:
+  TextMaterial();
+
+  Shader* shader() const override;
+
+  // Atlas page the glyphs are sampled from.
+  inline GLuint texture() const { return m_texture; }
+  inline void setTexture(GLuint t) { m_texture = t; }
+
+  inline QColor color() const { return m_color; }
+  inline void setColor(QColor c) { m_color = c; }
+
+  // Font size over the size of the atlas glyphs.
+  inline float scale() const { return m_scale; }
+  inline void setScale(float s) { m_scale = s; }
+};
+
+// Text laid out with QTextLayout and drawn from the GlyphAtlas of the share
+// group. Each node draws its glyphs with one draw per atlas page it uses;
+// the glyphs of different nodes are not merged, so many small texts still
+// cost a draw each. Layouts are cached by text, font and width. Call update()
+// from Item::synchronize() after changing the text, the atlas is filled on
+// the render thread.
+class TextNode : public Node {
+ private:
+  struct Page {
+    GeometryNode node;
+    Geometry geometry;
+    TextMaterial material;
+
+    Page();
+  };
+
+  std::vector<std::unique_ptr<Page>> m_page;
+  QString m_text;
+  QFont m_font;
+  QColor m_color;
+  qreal m_width;
+  QRectF m_boundingRect;
+  bool m_dirty;
+
+ public:
+  TextNode(Node* parent = nullptr);
+
+  inline QString text() const { return m_text; }
+  void setText(const QString&);
+
+  inline QFont font() const { return m_font; }
+  void setFont(const QFont&);
+
+  inline QColor color() const { return m_color; }
+  void setColor(QColor);
+
+  // Lines wrap at word boundaries to the width when it is positive.
+  inline qreal width() const { return m_width; }
+  void setWidth(qreal);
+
+  // Of the laid out lines, the first baseline is at the font's ascent.
+  inline QRectF boundingRect() const { return m_boundingRect; }
+
+  void update();
+};
+}  // namespace SceneGraph
+
+#endif  // TEXT_HPP
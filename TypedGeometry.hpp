@@ -0,0 +1,162 @@
+#ifndef TYPEDGEOMETRY_HPP
+#define TYPEDGEOMETRY_HPP
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Geometry.hpp"
+#include "VertexFormat.hpp"
+
+namespace SceneGraph {
+
+template <class T>
+struct GLType;
+template <>
+struct GLType<GLfloat> : std::integral_constant<GLenum, GL_FLOAT> {};
+template <>
+struct GLType<GLbyte> : std::integral_constant<GLenum, GL_BYTE> {};
+template <>
+struct GLType<GLubyte> : std::integral_constant<GLenum, GL_UNSIGNED_BYTE> {};
+template <>
+struct GLType<GLshort> : std::integral_constant<GLenum, GL_SHORT> {};
+template <>
+struct GLType<GLushort> : std::integral_constant<GLenum, GL_UNSIGNED_SHORT> {
+};
+template <>
+struct GLType<GLint> : std::integral_constant<GLenum, GL_INT> {};
+template <>
+struct GLType<GLuint> : std::integral_constant<GLenum, GL_UNSIGNED_INT> {};
+
+// Member of a vertex struct of type M at Offset, both written with
+// VERTEX_MEMBER so they come from the struct itself. M is T[N], or a single
+// T for one value or for a packed format. Type overrides the GL type for
+// formats without a C++ type of their own, e.g. a packed
+// VertexFormat::INT_2_10_10_10_REV held in one GLuint.
+template <class M, size_t Offset, bool Normalized = false,
+          GLenum Type = GLType<std::remove_extent_t<M>>::value>
+struct Field {
+  static_assert(!VertexFormat::isPacked(Type) || std::extent<M>::value == 0,
+                "Packed formats are held in a single value");
+
+  static constexpr int tupleSize =
+      VertexFormat::isPacked(Type) || std::extent<M>::value == 0
+          ? (VertexFormat::isPacked(Type) ? 4 : 1)
+          : int(std::extent<M>::value);
+  static constexpr GLenum primitiveType = Type;
+  static constexpr bool normalized = Normalized;
+  static constexpr uint offset = Offset;
+  static constexpr uint size = sizeof(M);
+};
+
+// Type and offset of a member of a vertex struct, the first arguments of its
+// Field.
+#define VERTEX_MEMBER(Vertex, member) \
+  decltype(Vertex::member), offsetof(Vertex, member)
+
+// Members of a vertex struct in declaration order.
+template <class... F>
+struct VertexLayout {
+  static constexpr uint count() { return sizeof...(F); }
+
+  static constexpr uint offset(uint index) {
+    const uint offset[] = {F::offset...};
+    return offset[index];
+  }
+
+  static constexpr uint stride() {
+    const uint end[] = {(F::offset + F::size)...};
+    return end[sizeof...(F) - 1];
+  }
+
+  // Whether the fields follow each other from the start of the vertex,
+  // without gaps. Together with a stride of the struct's size no member is
+  // left out.
+  static constexpr bool contiguous() {
+    const uint offset[] = {F::offset...};
+    const uint size[] = {F::size...};
+    if (offset[0] != 0) return false;
+    for (uint i = 1; i < sizeof...(F); i++)
+      if (offset[i] != offset[i - 1] + size[i - 1]) return false;
+    return true;
+  }
+
+  static std::vector<Attribute> attribute() {
+    return {{F::tupleSize, int(F::primitiveType), F::normalized,
+             int(F::offset)}...};
+  }
+
+  // Sets up all attributes with constant offsets, no loop over a layout.
+  template <size_t... I>
+  static void bind(QOpenGLFunctions* gl, const int* attributeLocation,
+                   std::index_sequence<I...>) {
+    using expand = int[];
+    (void)expand{
+        0, (gl->glEnableVertexAttribArray(attributeLocation[I]),
+            gl->glVertexAttribPointer(
+                attributeLocation[I], F::tupleSize, F::primitiveType,
+                F::normalized ? GL_TRUE : GL_FALSE, stride(),
+                reinterpret_cast<void*>(size_t(F::offset))),
+            0)...};
+  }
+
+  static inline void bind(QOpenGLFunctions* gl, const int* attributeLocation) {
+    bind(gl, attributeLocation, std::index_sequence_for<F...>());
+  }
+};
+
+// Layout of a vertex struct, specialized after the struct as offsetof needs
+// it complete.
+template <class Vertex>
+struct VertexLayoutOf;
+
+// Geometry whose layout comes from the members of the vertex struct at
+// compile time. The struct names its members as the shader declares them in
+// a static attribute(), and its VertexLayoutOf lists all of them:
+//
+//   struct ColorVertex {
+//     GLfloat position[2];
+//     GLubyte color[4];
+//
+//     static std::vector<std::string> attribute() {
+//       return {"position", "color"};
+//     }
+//   };
+//
+//   template <>
+//   struct VertexLayoutOf<ColorVertex>
+//       : VertexLayout<Field<VERTEX_MEMBER(ColorVertex, position)>,
+//                      Field<VERTEX_MEMBER(ColorVertex, color), true>> {};
+template <class Vertex>
+class TypedGeometry : public Geometry {
+ public:
+  using Layout = VertexLayoutOf<Vertex>;
+
+  static_assert(std::is_standard_layout<Vertex>::value &&
+                    std::is_trivially_copyable<Vertex>::value,
+                "Vertices are copied as bytes");
+  static_assert(Layout::contiguous() && sizeof(Vertex) == Layout::stride(),
+                "Vertex members are missing from the layout, out of order or "
+                "padded");
+
+ protected:
+  std::vector<std::string> attributeName() const override {
+    return Vertex::attribute();
+  }
+
+ public:
+  TypedGeometry(uint vertexCount = 0, uint indexCount = 0,
+                uint indexType = GL_UNSIGNED_INT)
+      : Geometry(Layout::attribute(), vertexCount, sizeof(Vertex), indexCount,
+                 indexType) {}
+
+  inline Vertex* vertices() const { return vertexData<Vertex>(); }
+
+  void bind(const int* attributeLocation) override {
+    bindBuffers();
+    Layout::bind(this, attributeLocation);
+  }
+};
+}  // namespace SceneGraph
+
+#endif  // TYPEDGEOMETRY_HPP
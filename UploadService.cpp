@@ -0,0 +1,190 @@
+#include "UploadService.hpp"
+#include <QDebug>
+#include <QImage>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLTexture>
+#include <cassert>
+#include "Geometry.hpp"
+#include "MeshFile.hpp"
+
+namespace SceneGraph {
+
+namespace {
+
+// Values missing from ES2 headers.
+const GLenum SYNC_GPU_COMMANDS_COMPLETE = 0x9117;
+const GLenum TIMEOUT_EXPIRED = 0x911B;
+
+bool fenceSupported(QOpenGLContext* context) {
+  QSurfaceFormat f = context->format();
+  int version = 10 * f.majorVersion() + f.minorVersion();
+  if (context->isOpenGLES()) return version >= 30;
+  return version >= 32 || context->hasExtension("GL_ARB_sync");
+}
+}  // namespace
+
+UploadService::UploadService(const QSurfaceFormat& format)
+    : m_renderThread(),
+      m_fenceSupported(),
+      m_stopping() {
+  m_surface.setFormat(format);
+  m_surface.create();
+}
+
+UploadService::~UploadService() { stop(); }
+
+void UploadService::start() {
+  assert(!m_loader);
+  QOpenGLContext* current = QOpenGLContext::currentContext();
+  assert(current);
+
+  m_context = std::make_unique<QOpenGLContext>();
+  m_context->setFormat(current->format());
+  m_context->setShareContext(current);
+  if (!m_context->create()) {
+    qDebug() << "[WARNING] Couldn't create the upload context, uploading "
+                "on the render thread.";
+    m_context = nullptr;
+    return;
+  }
+
+  m_renderThread = QThread::currentThread();
+  m_fenceSupported = fenceSupported(current);
+  m_stopping = false;
+
+  m_loader = std::make_unique<Loader>(this);
+  m_context->moveToThread(m_loader.get());
+  m_loader->start();
+}
+
+void UploadService::stop() {
+  if (m_loader) {
+    {
+      QMutexLocker lock(&m_mutex);
+      m_stopping = true;
+      m_condition.wakeAll();
+    }
+    m_loader->wait();
+    m_loader = nullptr;
+  }
+
+  // Their objects belong to the share group going away, and are dropped
+  // while the loader's context still exists.
+  QOpenGLContext* current = QOpenGLContext::currentContext();
+  for (Job& job : m_loaded)
+    if (job.fence && current)
+      current->extraFunctions()->glDeleteSync(job.fence);
+  m_loaded.clear();
+  m_context = nullptr;
+}
+
+void UploadService::run() {
+  m_context->makeCurrent(&m_surface);
+  QOpenGLExtraFunctions* gl = m_context->extraFunctions();
+
+  QMutexLocker lock(&m_mutex);
+  while (true) {
+    while (m_queue.empty() && !m_stopping) m_condition.wait(&m_mutex);
+    if (m_stopping) break;
+
+    Job job = std::move(m_queue.front());
+    m_queue.pop_front();
+    lock.unlock();
+
+    job.load();
+    if (m_fenceSupported) {
+      job.fence = gl->glFenceSync(SYNC_GPU_COMMANDS_COMPLETE, 0);
+      // The render thread polls the fence, which only signals once the
+      // commands before it were submitted.
+      gl->glFlush();
+    } else {
+      gl->glFinish();
+    }
+
+    lock.relock();
+    m_loaded.push_back(std::move(job));
+    if (m_notify) m_notify();
+  }
+  lock.unlock();
+
+  m_context->doneCurrent();
+  m_context->moveToThread(m_renderThread);
+}
+
+void UploadService::enqueue(std::function<void()> load,
+                            std::function<void()> ready) {
+  {
+    QMutexLocker lock(&m_mutex);
+    m_queue.push_back({std::move(load), std::move(ready), nullptr});
+    m_condition.wakeOne();
+  }
+  if (m_notify) m_notify();
+}
+
+bool UploadService::publish() {
+  std::deque<Job> ready;
+  {
+    QMutexLocker lock(&m_mutex);
+    if (!m_loader) std::swap(ready, m_queue);
+
+    QOpenGLExtraFunctions* gl =
+        QOpenGLContext::currentContext()->extraFunctions();
+    while (!m_loaded.empty()) {
+      Job& job = m_loaded.front();
+      if (job.fence) {
+        if (gl->glClientWaitSync(job.fence, 0, 0) == TIMEOUT_EXPIRED) break;
+        gl->glDeleteSync(job.fence);
+      }
+      ready.push_back(std::move(job));
+      m_loaded.pop_front();
+    }
+  }
+
+  for (Job& job : ready) {
+    if (!m_loader) job.load();
+    job.ready();
+  }
+
+  QMutexLocker lock(&m_mutex);
+  return !m_loaded.empty();
+}
+
+void UploadService::uploadTexture(
+    const QString& path,
+    std::function<void(std::unique_ptr<QOpenGLTexture>)> ready) {
+  upload<QImage>(
+      [path]() -> std::unique_ptr<QImage> {
+        QImage image(path);
+        if (image.isNull()) return nullptr;
+        return std::make_unique<QImage>(
+            image.convertToFormat(QImage::Format_RGBA8888));
+      },
+      [ready](std::unique_ptr<QImage> image) {
+        if (!image) {
+          ready(nullptr);
+          return;
+        }
+
+        auto texture = std::make_unique<QOpenGLTexture>(*image);
+        texture->setMinMagFilters(QOpenGLTexture::Linear,
+                                  QOpenGLTexture::Linear);
+        ready(std::move(texture));
+      });
+}
+
+void UploadService::uploadMesh(
+    const QString& path, std::function<void(std::unique_ptr<Geometry>)> ready) {
+  upload<Geometry>(
+      [path]() -> std::unique_ptr<Geometry> {
+        MeshFile file;
+        if (!file.open(path)) return nullptr;
+        return file.createGeometry();
+      },
+      [ready](std::unique_ptr<Geometry> geometry) {
+        // Its buffers are shared, but the functions were resolved for the
+        // loader's context.
+        if (geometry) geometry->initializeOpenGLFunctions();
+        ready(std::move(geometry));
+      });
+}
+}  // namespace SceneGraph
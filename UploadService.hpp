@@ -0,0 +1,103 @@
+#ifndef UPLOADSERVICE_HPP
+#define UPLOADSERVICE_HPP
+#include <QMutex>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QThread>
+#include <QWaitCondition>
+#include <deque>
+#include <functional>
+#include <memory>
+
+class QOpenGLTexture;
+
+namespace SceneGraph {
+
+class Geometry;
+
+// Creates and fills buffers and decodes textures on a loader thread, whose
+// context shares with the render thread's. A result reaches the render thread
+// in publish() once a fence shows the commands that made it completed, so
+// large assets load without taking frame time. Without fence sync the loader
+// waits for its commands with glFinish() instead.
+class UploadService {
+ private:
+  struct Job {
+    std::function<void()> load;
+    std::function<void()> ready;
+    GLsync fence;
+  };
+
+  class Loader : public QThread {
+   private:
+    UploadService* m_service;
+
+   protected:
+    inline void run() override { m_service->run(); }
+
+   public:
+    explicit Loader(UploadService* s) : m_service(s) {}
+  };
+
+  QOffscreenSurface m_surface;
+  std::unique_ptr<QOpenGLContext> m_context;
+  std::unique_ptr<Loader> m_loader;
+  QThread* m_renderThread;
+  bool m_fenceSupported;
+  std::function<void()> m_notify;
+
+  QMutex m_mutex;
+  QWaitCondition m_condition;
+  std::deque<Job> m_queue;
+  std::deque<Job> m_loaded;
+  bool m_stopping;
+
+  void run();
+  void enqueue(std::function<void()> load, std::function<void()> ready);
+
+ public:
+  // On the GUI thread, which has to create the offscreen surface.
+  explicit UploadService(const QSurfaceFormat&);
+  ~UploadService();
+
+  // Starts the loader on the render thread, with a context sharing with the
+  // current one.
+  void start();
+  // Stops the loader before the render thread's context goes away. Queued
+  // work waits for the next start(), results not published yet are dropped.
+  void stop();
+
+  // Runs load on the loader thread with its context current, and hands the
+  // result to ready on the render thread. Callable from any thread. The
+  // loader's context goes away with stop(), so results may only keep GL names
+  // from it; objects holding functions or the context have to be set up
+  // again for the render thread's in ready.
+  template <class T>
+  void upload(std::function<std::unique_ptr<T>()> load,
+              std::function<void(std::unique_ptr<T>)> ready) {
+    auto result = std::make_shared<std::unique_ptr<T>>();
+    enqueue([result, load] { *result = load(); },
+            [result, ready] { ready(std::move(*result)); });
+  }
+
+  // Null results for files which couldn't be read. Textures are decoded on
+  // the loader but created in publish(), as QOpenGLTexture keeps the context
+  // it was created in and can't take over a texture name.
+  void uploadTexture(const QString& path,
+                     std::function<void(std::unique_ptr<QOpenGLTexture>)>);
+  void uploadMesh(const QString& path,
+                  std::function<void(std::unique_ptr<Geometry>)>);
+
+  // Calls ready for the completed uploads, on the render thread. Returns
+  // whether loaded results still wait for their fences. Runs the queued work
+  // right here when the loader couldn't start.
+  bool publish();
+
+  // Called whenever there is something new to publish, e.g. to schedule a
+  // frame: on the loader thread for results, on the calling thread for new
+  // work. Set before start().
+  inline void setNotify(std::function<void()> f) { m_notify = std::move(f); }
+};
+}  // namespace SceneGraph
+
+#endif  // UPLOADSERVICE_HPP
@@ -0,0 +1,110 @@
+#include "VertexFormat.hpp"
+#include <QOpenGLContext>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace SceneGraph {
+namespace VertexFormat {
+
+namespace {
+
+float clamp(float v, float lo, float hi) { return std::min(std::max(v, lo), hi); }
+
+template <class T>
+T snorm(float v, int bits) {
+  float scale = float((1 << (bits - 1)) - 1);
+  return T(std::lround(clamp(v, -1, 1) * scale));
+}
+}  // namespace
+
+GLenum halfFloatType() {
+  QOpenGLContext* context = QOpenGLContext::currentContext();
+  if (context->isOpenGLES() && context->format().majorVersion() < 3)
+    return HALF_FLOAT_OES;
+  return HALF_FLOAT;
+}
+
+uint16_t toHalf(float value) {
+  uint32_t f;
+  memcpy(&f, &value, sizeof(f));
+
+  uint32_t sign = (f >> 16) & 0x8000;
+  int32_t exponent = int32_t((f >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = f & 0x7fffff;
+
+  if (((f >> 23) & 0xff) == 0xff)
+    return uint16_t(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+  if (exponent >= 31) return uint16_t(sign | 0x7c00);
+  if (exponent <= 0) {
+    if (exponent < -10) return uint16_t(sign);
+    mantissa |= 0x800000;
+    uint32_t shift = uint32_t(14 - exponent);
+    uint32_t half = mantissa >> shift;
+    // Round to nearest even.
+    uint32_t rest = mantissa & ((1u << shift) - 1), midpoint = 1u << (shift - 1);
+    if (rest > midpoint || (rest == midpoint && (half & 1))) half++;
+    return uint16_t(sign | half);
+  }
+
+  uint32_t half = sign | (uint32_t(exponent) << 10) | (mantissa >> 13);
+  uint32_t rest = mantissa & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+  return uint16_t(half);
+}
+
+float fromHalf(uint16_t h) {
+  uint32_t sign = uint32_t(h & 0x8000) << 16;
+  uint32_t exponent = (h >> 10) & 0x1f;
+  uint32_t mantissa = h & 0x3ff;
+
+  uint32_t f;
+  if (exponent == 0) {
+    if (mantissa == 0) {
+      f = sign;
+    } else {
+      exponent = 127 - 15 + 1;
+      while (!(mantissa & 0x400)) {
+        mantissa <<= 1;
+        exponent--;
+      }
+      f = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+  } else if (exponent == 31) {
+    f = sign | 0x7f800000 | (mantissa << 13);
+  } else {
+    f = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+  }
+
+  float value;
+  memcpy(&value, &f, sizeof(value));
+  return value;
+}
+
+uint8_t toUnorm8(float v) { return uint8_t(std::lround(clamp(v, 0, 1) * 255)); }
+
+int8_t toSnorm8(float v) { return snorm<int8_t>(v, 8); }
+
+uint16_t toUnorm16(float v) {
+  return uint16_t(std::lround(clamp(v, 0, 1) * 65535));
+}
+
+int16_t toSnorm16(float v) { return snorm<int16_t>(v, 16); }
+
+uint32_t packColor(QColor c) {
+  uint8_t rgba[] = {toUnorm8(float(c.redF())), toUnorm8(float(c.greenF())),
+                    toUnorm8(float(c.blueF())), toUnorm8(float(c.alphaF()))};
+  uint32_t result;
+  memcpy(&result, rgba, sizeof(result));
+  return result;
+}
+
+uint32_t packSnorm1010102(float x, float y, float z, float w) {
+  auto field = [](float v, int bits) {
+    return uint32_t(snorm<int32_t>(v, bits)) & ((1u << bits) - 1);
+  };
+  return field(x, 10) | field(y, 10) << 10 | field(z, 10) << 20 |
+         field(w, 2) << 30;
+}
+}  // namespace VertexFormat
+}  // namespace SceneGraph
@@ -0,0 +1,44 @@
+#ifndef VERTEXFORMAT_HPP
+#define VERTEXFORMAT_HPP
+#include <QColor>
+#include <QOpenGLFunctions>
+#include <cstdint>
+
+namespace SceneGraph {
+
+// Conversions into the compact attribute types, for vertex data that does
+// not need 32 bit floats. Normalized types need Attribute::normalized.
+namespace VertexFormat {
+
+// Values of the types missing from some GL headers.
+const GLenum HALF_FLOAT = 0x140B;
+const GLenum HALF_FLOAT_OES = 0x8D61;
+const GLenum INT_2_10_10_10_REV = 0x8D9F;
+const GLenum UNSIGNED_INT_2_10_10_10_REV = 0x8368;
+
+constexpr bool isPacked(GLenum type) {
+  return type == INT_2_10_10_10_REV || type == UNSIGNED_INT_2_10_10_10_REV;
+}
+
+// Half float type of the current context, ES2 only has the OES one.
+GLenum halfFloatType();
+
+uint16_t toHalf(float);
+float fromHalf(uint16_t);
+
+// Normalized integers, clamped to the range of the type.
+uint8_t toUnorm8(float);
+int8_t toSnorm8(float);
+uint16_t toUnorm16(float);
+int16_t toSnorm16(float);
+
+// Four normalized bytes in memory order r, g, b, a.
+uint32_t packColor(QColor);
+
+// Signed normalized x, y and z in 10 bits each and w in 2, for normals and
+// tangents with INT_2_10_10_10_REV.
+uint32_t packSnorm1010102(float x, float y, float z, float w = 0);
+}  // namespace VertexFormat
+}  // namespace SceneGraph
+
+#endif  // VERTEXFORMAT_HPP
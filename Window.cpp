@@ -2,10 +2,12 @@
 #include <QOpenGLFramebufferObject>
 #include <QQuickItem>
 #include <QThread>
+#include <algorithm>
 #include <cassert>
 #include <functional>
 #include "DefaultRenderer.hpp"
 #include "Node.hpp"
+#include "UploadService.hpp"
 
 #if defined(Q_OS_LINUX) and not defined(Q_OS_ANDROID)
 #define USE_X11
@@ -23,16 +25,39 @@
 
 namespace SceneGraph {
 
+namespace {
+
+const qreal MINIMUM_FRAME_RATE = 10;
+const int FRAME_INTERVAL_STEP = 8;
+}  // namespace
+
 Window::Window(QWindow* parent)
     : QQuickView(parent),
       m_rootItem(this, contentItem()),
       m_renderer(),
+      m_uploadService(std::make_unique<UploadService>(requestedFormat())),
+      m_uploadPending(),
       m_focusItem(),
       m_lockedCursor(),
       m_allowLockCursor(true),
-      m_fps() {
+      m_fps(),
+      m_adaptiveFrameRate(),
+      m_minimumFrameRate(MINIMUM_FRAME_RATE),
+      m_frameInterval(),
+      m_frameElided(),
+      m_elidedFrames() {
   m_root.setWindow(this);
   m_fpscounter.restart();
+  m_frameTimer.start();
+  m_changeTimer.start();
+
+  // Results are published while synchronizing.
+  m_uploadService->setNotify([this] {
+    QMetaObject::invokeMethod(this, [this] { update(); });
+  });
+
+  m_scheduleTimer.setSingleShot(true);
+  connect(&m_scheduleTimer, &QTimer::timeout, this, &QQuickWindow::update);
 
   connect(this, &QQuickWindow::sceneGraphInitialized, this,
           &Window::onSceneGraphInitialized, Qt::DirectConnection);
@@ -69,7 +94,43 @@ void Window::setProjection(const QMatrix4x4& m) {
   scheduleSynchronize();
 }
 
-void Window::scheduleSynchronize() { update(); }
+void Window::scheduleSynchronize() {
+  qint64 wait = m_frameInterval - m_frameTimer.elapsed();
+  if (wait <= 0)
+    update();
+  else if (!m_scheduleTimer.isActive())
+    m_scheduleTimer.start(int(wait));
+}
+
+void Window::setAdaptiveFrameRate(bool e) {
+  m_adaptiveFrameRate = e;
+  resetFrameInterval();
+}
+
+void Window::resetFrameInterval() {
+  m_frameInterval = 0;
+  if (m_scheduleTimer.isActive()) {
+    m_scheduleTimer.stop();
+    update();
+  }
+}
+
+void Window::updateFrameInterval() {
+  if (!m_adaptiveFrameRate || m_minimumFrameRate <= 0) {
+    m_frameInterval = 0;
+    return;
+  }
+
+  // Unchanged frames back off step by step, changed ones set the interval to
+  // half of the time since the previous change, so steady animations still
+  // get every frame they need.
+  int maximum = int(1000 / m_minimumFrameRate);
+  if (m_frameElided)
+    m_frameInterval = std::min(maximum, m_frameInterval + FRAME_INTERVAL_STEP);
+  else
+    m_frameInterval =
+        int(std::min<qint64>(maximum, m_changeTimer.restart() / 2));
+}
 
 QOpenGLTexture* Window::texture(const char* path) {
   return m_renderer->texture(path);
@@ -80,6 +141,7 @@ void Window::onSceneGraphInitialized() {
   m_glVersion = m_renderer->glVersion();
   m_renderer->setRoot(rootItem());
   rootItem()->updateSubtree();
+  m_uploadService->start();
 }
 
 void Window::onSceneGraphInvalidated() {
@@ -87,17 +149,28 @@ void Window::onSceneGraphInvalidated() {
   rootItem()->invalidateSubtree();
   m_renderer->synchronize(this);
 
+  m_uploadService->stop();
   m_renderer = nullptr;
 }
 
 void Window::onBeforeRendering() {
   resetOpenGLState();
   m_renderer->render();
+
+  m_frameElided = m_renderer->frameElided();
+  if (m_frameElided) m_elidedFrames++;
+
+  if (m_renderer->frameRequested() || m_uploadPending) update();
 }
 
 void Window::onBeforeSynchronizing() {
   qint64 t = m_fpscounter.restart();
   if (t != 0) m_fps = 1000.0 / t;
+
+  updateFrameInterval();
+  m_frameTimer.restart();
+
+  m_uploadPending = m_uploadService->publish();
   m_renderer->synchronize(this);
 }
 
@@ -160,6 +233,7 @@ void Window::removeTimer(Item* item, int timerId) {
 }
 
 void Window::keyPressEvent(QKeyEvent* event) {
+  resetFrameInterval();
   QQuickView::keyPressEvent(event);
   if (event->isAccepted()) return;
 
@@ -190,6 +264,7 @@ void Window::keyReleaseEvent(QKeyEvent* event) {
 }
 
 void Window::touchEvent(QTouchEvent* e) {
+  resetFrameInterval();
   QQuickView::touchEvent(e);
   if (e->isAccepted()) return;
 
@@ -232,6 +307,7 @@ void Window::touchEvent(QTouchEvent* e) {
 }
 
 void Window::mousePressEvent(QMouseEvent* event) {
+  resetFrameInterval();
   QQuickView::mousePressEvent(event);
   if (event->isAccepted()) return;
 
@@ -264,6 +340,7 @@ void Window::mouseReleaseEvent(QMouseEvent* event) {
 }
 
 void Window::mouseMoveEvent(QMouseEvent* event) {
+  resetFrameInterval();
   QQuickView::mouseMoveEvent(event);
   if (event->isAccepted()) return;
 
@@ -279,6 +356,7 @@ void Window::mouseMoveEvent(QMouseEvent* event) {
 }
 
 void Window::wheelEvent(QWheelEvent* event) {
+  resetFrameInterval();
   QQuickView::wheelEvent(event);
   if (event->isAccepted()) return;
 
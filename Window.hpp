@@ -3,16 +3,21 @@
 #include <QElapsedTimer>
 #include <QQuickItem>
 #include <QQuickView>
+#include <QTimer>
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
 #include "Item.hpp"
+#include "Material.hpp"
 
 class QOpenGLTexture;
 
 namespace SceneGraph {
 
 class Renderer;
+class UploadService;
 
 class Window : public QQuickView {
  private:
@@ -32,6 +37,8 @@ class Window : public QQuickView {
   } m_rootItem;
 
   std::unique_ptr<Renderer> m_renderer;
+  std::unique_ptr<UploadService> m_uploadService;
+  bool m_uploadPending;
   QMatrix4x4 m_projection;
 
   Item m_root;
@@ -39,6 +46,7 @@ class Window : public QQuickView {
   std::vector<Item*> m_updateItem;
   std::vector<std::unique_ptr<Node>> m_destroyedItemNode;
   std::vector<std::unique_ptr<Node>> m_destroyedNode;
+  std::vector<std::function<Shader*()>> m_warmUpShader;
 
   std::unordered_map<int, Item*> m_timerItem;
   std::unordered_map<Item*, std::unordered_set<int>> m_timerMap;
@@ -51,6 +59,15 @@ class Window : public QQuickView {
   qreal m_fps;
   QElapsedTimer m_fpscounter;
 
+  bool m_adaptiveFrameRate;
+  qreal m_minimumFrameRate;
+  int m_frameInterval;
+  QElapsedTimer m_frameTimer;
+  QElapsedTimer m_changeTimer;
+  QTimer m_scheduleTimer;
+  std::atomic<bool> m_frameElided;
+  std::atomic<uint> m_elidedFrames;
+
   void onSceneGraphInitialized();
   void onSceneGraphInvalidated();
   void onBeforeRendering();
@@ -68,6 +85,14 @@ class Window : public QQuickView {
   bool unlockCursor();
 
   void fixCursor();
+  void updateFrameInterval();
+  void resetFrameInterval();
+
+  template <class MaterialType>
+  static Shader* materialShader() {
+    MaterialType material;
+    return static_cast<Material&>(material).shader();
+  }
 
  protected:
   void keyPressEvent(QKeyEvent*);
@@ -96,6 +121,18 @@ class Window : public QQuickView {
 
   QOpenGLTexture* texture(const char* path);
 
+  // Loads buffers and textures on a background context, see UploadService.
+  inline UploadService* uploadService() const { return m_uploadService.get(); }
+
+  // Links the shaders of the given material types ahead of their first draw,
+  // in the background where the driver supports parallel compilation.
+  template <class... MaterialType>
+  void warmUpShaders() {
+    m_warmUpShader.insert(m_warmUpShader.end(),
+                          {&Window::materialShader<MaterialType>...});
+    scheduleSynchronize();
+  }
+
   inline bool lockedCursor() const { return m_lockedCursor; }
   void setLockedCursor(bool);
 
@@ -108,6 +145,20 @@ class Window : public QQuickView {
   System system() const;
   inline qreal fps() const { return m_fps; }
 
+  // Frames the renderer skipped since nothing had changed.
+  inline uint elidedFrames() const { return m_elidedFrames; }
+
+  // Spaces frames out while they keep turning out unchanged, or while changes
+  // arrive slower than the display refreshes, down to the minimum frame rate.
+  // Input brings the full rate back.
+  inline bool adaptiveFrameRate() const { return m_adaptiveFrameRate; }
+  void setAdaptiveFrameRate(bool);
+
+  inline qreal minimumFrameRate() const { return m_minimumFrameRate; }
+  inline void setMinimumFrameRate(qreal r) { m_minimumFrameRate = r; }
+
+  inline int frameInterval() const { return m_frameInterval; }
+
   static std::string systemToString(System);
 };
 }  //  namespace SceneGraph
@@ -0,0 +1,153 @@
+#include <QCoreApplication>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+#include <cstdio>
+#include <map>
+#include <tuple>
+#include <vector>
+#include "MeshFile.hpp"
+#include "MeshOptimizer.hpp"
+
+using namespace SceneGraph;
+
+namespace {
+
+// Triangulated Wavefront OBJ with the vertex attributes it has: position,
+// then texture coordinates and normals when present.
+bool readObj(const QString& path, std::vector<Attribute>& attribute,
+             std::vector<float>& vertex, std::vector<GLuint>& index) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) return false;
+
+  std::vector<float> position, tcoord, normal;
+  using Key = std::tuple<int, int, int>;
+  std::vector<std::vector<Key>> face;
+
+  QTextStream stream(&file);
+  QString line;
+  while (stream.readLineInto(&line)) {
+    QStringList field = line.simplified().split(' ');
+    if (field.isEmpty()) continue;
+    const QString& type = field[0];
+    if (type == "v" && field.size() >= 4) {
+      for (int i = 1; i <= 3; i++) position.push_back(field[i].toFloat());
+    } else if (type == "vt" && field.size() >= 3) {
+      for (int i = 1; i <= 2; i++) tcoord.push_back(field[i].toFloat());
+    } else if (type == "vn" && field.size() >= 4) {
+      for (int i = 1; i <= 3; i++) normal.push_back(field[i].toFloat());
+    } else if (type == "f" && field.size() >= 4) {
+      // Negative indices count from the end, missing ones are -1. Others
+      // have to refer to elements read before the face.
+      bool valid = true;
+      auto resolve = [&valid](const QString& s, size_t count) {
+        if (s.isEmpty()) return -1;
+        int i = s.toInt();
+        int resolved = i < 0 ? int(count) + i : i - 1;
+        if (resolved < 0 || size_t(resolved) >= count) valid = false;
+        return resolved;
+      };
+      std::vector<Key> polygon;
+      for (int i = 1; i < field.size(); i++) {
+        QStringList part = field[i].split('/');
+        polygon.emplace_back(
+            resolve(part.value(0), position.size() / 3),
+            resolve(part.value(1), tcoord.size() / 2),
+            resolve(part.value(2), normal.size() / 3));
+      }
+      if (!valid) return false;
+      face.push_back(polygon);
+    }
+  }
+
+  bool hasTcoord = !tcoord.empty(), hasNormal = !normal.empty();
+  attribute = {{3, GL_FLOAT}};
+  if (hasTcoord) attribute.push_back({2, GL_FLOAT});
+  if (hasNormal) attribute.push_back({3, GL_FLOAT});
+
+  std::map<Key, GLuint> welded;
+  auto vertexId = [&](const Key& key) {
+    auto it = welded.find(key);
+    if (it != welded.end()) return it->second;
+
+    int p, t, n;
+    std::tie(p, t, n) = key;
+    for (int i = 0; i < 3; i++)
+      vertex.push_back(p >= 0 ? position[3 * p + i] : 0);
+    if (hasTcoord)
+      for (int i = 0; i < 2; i++)
+        vertex.push_back(t >= 0 ? tcoord[2 * t + i] : 0);
+    if (hasNormal)
+      for (int i = 0; i < 3; i++)
+        vertex.push_back(n >= 0 ? normal[3 * n + i] : 0);
+
+    GLuint id = GLuint(welded.size());
+    welded[key] = id;
+    return id;
+  };
+
+  // Polygons as fans.
+  for (const std::vector<Key>& polygon : face)
+    for (size_t i = 1; i + 1 < polygon.size(); i++) {
+      index.push_back(vertexId(polygon[0]));
+      index.push_back(vertexId(polygon[i]));
+      index.push_back(vertexId(polygon[i + 1]));
+    }
+  return true;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  QCoreApplication app(argc, argv);
+  QStringList argument = QCoreApplication::arguments();
+  if (argument.size() != 3) {
+    fprintf(stderr, "usage: meshconvert input.obj output.mesh\n");
+    return 1;
+  }
+
+  std::vector<Attribute> attribute;
+  std::vector<float> vertex;
+  std::vector<GLuint> index;
+  if (!readObj(argument[1], attribute, vertex, index)) {
+    fprintf(stderr, "couldn't read %s\n", argument[1].toLocal8Bit().data());
+    return 1;
+  }
+
+  uint floats = 0;
+  for (const Attribute& a : attribute) floats += a.tupleSize;
+
+  MeshOptimizer::Mesh optimized = {
+      std::vector<char>(reinterpret_cast<const char*>(vertex.data()),
+                        reinterpret_cast<const char*>(vertex.data() +
+                                                      vertex.size())),
+      uint(floats * sizeof(float)),
+      0,
+      3,
+      std::vector<uint32_t>(index.begin(), index.end()),
+      sizeof(GLuint)};
+  MeshOptimizer::Statistics s = MeshOptimizer::optimize(optimized);
+
+  // 16 bit indices whenever they are enough.
+  bool useShort = optimized.indexSize == 2;
+  std::vector<GLushort> shortIndex;
+  if (useShort)
+    shortIndex.assign(optimized.index.begin(), optimized.index.end());
+  else
+    index.assign(optimized.index.begin(), optimized.index.end());
+
+  MeshFile::Mesh mesh = {
+      attribute,
+      optimized.vertexSize,
+      s.vertexCount[1],
+      optimized.vertex.data(),
+      uint(optimized.index.size()),
+      uint(useShort ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT),
+      useShort ? static_cast<const void*>(shortIndex.data()) : index.data(),
+      GL_TRIANGLES};
+  if (!MeshFile::write(argument[2], mesh)) return 1;
+
+  printf("%u vertices, %u triangles\n", s.vertexCount[1], s.triangleCount);
+  printf("cache misses per triangle %.3f -> %.3f, %zu -> %zu bytes\n",
+         s.acmr[0], s.acmr[1], s.bytes[0], s.bytes[1]);
+  return 0;
+}
@@ -0,0 +1,15 @@
+QT = core gui concurrent
+CONFIG += c++14 console
+CONFIG -= app_bundle debug_and_release
+TARGET = meshconvert
+TEMPLATE = app
+OBJECTS_DIR = .obj
+INCLUDEPATH += ../..
+
+SOURCES += \
+    main.cpp \
+    ../../BoundingBox.cpp \
+    ../../Geometry.cpp \
+    ../../MeshFile.cpp \
+    ../../MeshOptimizer.cpp \
+    ../../VertexFormat.cpp